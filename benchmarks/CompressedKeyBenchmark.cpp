@@ -0,0 +1,166 @@
+/**
+ * @file CompressedKeyBenchmark.cpp
+ *
+ * @brief Last mile search over frame of reference compressed keys against plain (key, value) pairs
+ *
+ * Usage: compressed_key_benchmark [numKeys] [numLookups]
+ *
+ * First each search runs alone over windows of several sizes around the position of each query, as the
+ * window an error bound gives. Then whole indexes with and without enableCompressedKeys answer the same
+ * findBatch queries. The indexes load linear models of the uniform keys instead of training, so both search
+ * the same windows whatever the network trains to.
+ *
+ * @date 10/19/2026
+ */
+
+#include "../src/RecursiveModelIndex.h"
+#include "../src/CompressedKeyArray.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+typedef std::pair<long, long> Pair;
+
+/**
+ * @brief Time a search over each query's window, the search returns the position it found
+ */
+template <typename Search>
+void benchmarkSearch(const std::string &name, const std::vector<long> &queries, const std::vector<size_t> &starts,
+                     size_t windowSize, Search search) {
+    size_t checksum = 0;
+    auto startTime = std::chrono::steady_clock::now();
+    for (size_t ii = 0; ii < queries.size(); ++ii) {
+        checksum += search(starts[ii], starts[ii] + windowSize, queries[ii]);
+    }
+    auto endTime = std::chrono::steady_clock::now();
+
+    std::chrono::duration<double, std::nano> duration = endTime - startTime;
+    std::cout << "  " << name << ": " << duration.count() / queries.size() << " ns/search (checksum " << checksum
+              << ")" << std::endl;
+}
+
+/**
+ * @brief Time findBatch on an index over the keys with the models in weightPath
+ */
+void benchmarkIndex(const std::string &name, const std::vector<long> &keys, const std::vector<long> &queries,
+                    const std::string &weightPath, bool compressKeys) {
+    NetworkParameters firstStageParams;
+    firstStageParams.batchSize = 256;
+    firstStageParams.maxNumEpochs = 1000;
+    firstStageParams.learningRate = 0.01;
+    firstStageParams.numNeurons = 8;
+
+    NetworkParameters secondStageParams;
+    secondStageParams.batchSize = 64;
+    secondStageParams.maxNumEpochs = 100;
+    secondStageParams.learningRate = 0.01;
+
+    RecursiveModelIndex<long, long, 1024> index(firstStageParams, secondStageParams, static_cast<int>(keys.size()),
+                                                static_cast<int>(keys.size()));
+    if (!index.loadModels(weightPath)) {
+        return;
+    }
+    if (compressKeys) {
+        index.enableCompressedKeys();
+    }
+    for (auto key : keys) {
+        index.insert(key, key + 1);
+    }
+    index.train();
+
+    std::vector<boost::optional<Pair>> results;
+    auto startTime = std::chrono::steady_clock::now();
+    index.findBatch(queries, results);
+    auto endTime = std::chrono::steady_clock::now();
+
+    size_t numFound = std::count_if(results.begin(), results.end(), [](const boost::optional<Pair> &result) {
+        return static_cast<bool>(result);
+    });
+    std::chrono::duration<double, std::nano> duration = endTime - startTime;
+    std::cout << name << " index: findBatch " << duration.count() / queries.size() << " ns/lookup (found "
+              << numFound << ")" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    size_t numKeys = argc > 1 ? std::stoull(argv[1]) : (1 << 22);
+    size_t numLookups = argc > 2 ? std::stoull(argv[2]) : (1 << 22);
+    std::cout << "Keys: " << numKeys << " Lookups: " << numLookups << std::endl;
+
+    const long maxKey = static_cast<long>(numKeys) * 16;
+    std::mt19937_64 rng(0);
+    std::uniform_int_distribution<long> distribution(0, maxKey);
+    std::vector<long> keys(numKeys);
+    for (auto &key : keys) {
+        key = distribution(rng);
+    }
+
+    std::vector<Pair> data(numKeys);
+    std::sort(keys.begin(), keys.end());
+    for (size_t ii = 0; ii < numKeys; ++ii) {
+        data[ii] = {keys[ii], keys[ii] + 1};
+    }
+    CompressedKeyArray<long> compressedKeys;
+    compressedKeys.build(data);
+    std::cout << "Keys take " << numKeys * sizeof(long) << " bytes plain, " << compressedKeys.memoryUsage()
+              << " compressed" << std::endl;
+
+    // Half of the queries are stored keys, the rest are mostly misses
+    std::vector<long> queries(numLookups);
+    for (size_t ii = 0; ii < numLookups; ++ii) {
+        queries[ii] = ii % 2 ? keys[rng() % numKeys] : distribution(rng);
+    }
+
+    auto compareKey = [](const Pair &pair, long key) {
+        return pair.first < key;
+    };
+    for (size_t windowSize : {16, 64, 256, 1024}) {
+        if (windowSize > numKeys) {
+            break;
+        }
+
+        // Each window holds the query's position, at a random place in the window
+        std::vector<size_t> starts(numLookups);
+        for (size_t ii = 0; ii < numLookups; ++ii) {
+            size_t position = std::lower_bound(data.begin(), data.end(), queries[ii], compareKey) - data.begin();
+            size_t start = position - std::min(position, static_cast<size_t>(rng() % windowSize));
+            starts[ii] = std::min(start, numKeys - windowSize);
+        }
+
+        std::cout << "Window of " << windowSize << " keys" << std::endl;
+        benchmarkSearch("Plain scan", queries, starts, windowSize, [&](size_t startIdx, size_t endIdx, long key) {
+            auto result = std::find_if(data.begin() + startIdx, data.begin() + endIdx, [&](const Pair &pair) {
+                return !(pair.first < key);
+            });
+            return static_cast<size_t>(result - data.begin());
+        });
+        benchmarkSearch("Plain binary search", queries, starts, windowSize, [&](size_t startIdx, size_t endIdx, long key) {
+            return static_cast<size_t>(std::lower_bound(data.begin() + startIdx, data.begin() + endIdx, key, compareKey) -
+                                       data.begin());
+        });
+        benchmarkSearch("Compressed", queries, starts, windowSize, [&](size_t startIdx, size_t endIdx, long key) {
+            return compressedKeys.lowerBound(startIdx, endIdx, key);
+        });
+    }
+
+    // Both stages predict key / maxKey, the CDF of uniform keys
+    const std::string weightPath = "compressed_key_benchmark.weights";
+    FirstStageWeights firstStage;
+    firstStage.hiddenWeight = {1.0f};
+    firstStage.hiddenBias = {0.0f};
+    firstStage.outputWeight = {1.0f / maxKey};
+    std::vector<LinearModelWeights> secondStage(1024);
+    for (auto &model : secondStage) {
+        model.weight = 1.0f / maxKey;
+    }
+    if (!saveModelWeights(weightPath, firstStage, secondStage)) {
+        return 1;
+    }
+
+    benchmarkIndex("Plain", keys, queries, weightPath, false);
+    benchmarkIndex("Compressed", keys, queries, weightPath, true);
+    std::remove(weightPath.c_str());
+    return 0;
+}
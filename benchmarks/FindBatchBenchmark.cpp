@@ -0,0 +1,126 @@
+/**
+ * @file FindBatchBenchmark.cpp
+ *
+ * @brief Batched lookups with findBatch against a loop of find, on data much larger than the cache
+ *
+ * Usage: find_batch_benchmark [numKeys] [numLookups]
+ *
+ * The keys are uniform, and the index loads linear models of their range instead of training, so the windows are
+ * realistic whatever the network trains to. Each index is built twice: once with an error bound so loose every
+ * node searches its model's window, and once with a bound of zero so every node falls back to its B-tree.
+ * findBatch interleaves the window searches, but walks each B-tree to the end before moving on, so only the
+ * second case shows what the trees cost it.
+ *
+ * @date 10/19/2026
+ */
+
+#include "../src/RecursiveModelIndex.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+typedef RecursiveModelIndex<long, long, 1024> Index;
+typedef std::vector<boost::optional<std::pair<long, long>>> Results;
+
+/**
+ * @brief Time a lookup function that fills results for every query
+ */
+template <typename Lookup>
+void benchmarkLookups(const std::string &name, const std::vector<long> &queries, Lookup lookup) {
+    Results results;
+    auto startTime = std::chrono::steady_clock::now();
+    lookup(results);
+    auto endTime = std::chrono::steady_clock::now();
+
+    size_t numFound = std::count_if(results.begin(), results.end(), [](const boost::optional<std::pair<long, long>> &result) {
+        return static_cast<bool>(result);
+    });
+    std::chrono::duration<double, std::nano> duration = endTime - startTime;
+    std::cout << name << ": " << duration.count() / queries.size() << " ns/lookup (found " << numFound << ")" << std::endl;
+}
+
+/**
+ * @brief Build an index on the keys with the models in weightPath, with nodes over maxSecondStageError using their
+ * B-tree, and time its lookups
+ */
+void benchmarkIndex(const std::string &name, const std::vector<long> &keys, const std::vector<long> &queries,
+                    const std::string &weightPath, int maxSecondStageError) {
+    NetworkParameters firstStageParams;
+    firstStageParams.batchSize = 256;
+    firstStageParams.maxNumEpochs = 1000;
+    firstStageParams.learningRate = 0.01;
+    firstStageParams.numNeurons = 8;
+
+    NetworkParameters secondStageParams;
+    secondStageParams.batchSize = 64;
+    secondStageParams.maxNumEpochs = 100;
+    secondStageParams.learningRate = 0.01;
+
+    Index index(firstStageParams, secondStageParams, maxSecondStageError, static_cast<int>(keys.size()));
+    if (!index.loadModels(weightPath)) {
+        return;
+    }
+    for (auto key : keys) {
+        index.insert(key, key + 1);
+    }
+    index.train();
+
+    std::cout << name << std::endl;
+    benchmarkLookups("  find loop", queries, [&](Results &results) {
+        // find logs every lookup, mute stdout so the loop measures the search and not the logging
+        std::streambuf *output = std::cout.rdbuf(nullptr);
+        results.resize(queries.size());
+        for (size_t ii = 0; ii < queries.size(); ++ii) {
+            results[ii] = index.find(queries[ii]);
+        }
+        std::cout.rdbuf(output);
+        std::cout.clear();
+    });
+    for (size_t numInFlight : {1, 4, 8, 16, 32}) {
+        benchmarkLookups("  findBatch, " + std::to_string(numInFlight) + " in flight", queries, [&](Results &results) {
+            index.findBatch(queries, results, numInFlight);
+        });
+    }
+}
+
+int main(int argc, char **argv) {
+    size_t numKeys = argc > 1 ? std::stoull(argv[1]) : (1 << 22);
+    size_t numLookups = argc > 2 ? std::stoull(argv[2]) : (1 << 22);
+    std::cout << "Keys: " << numKeys << " Lookups: " << numLookups << std::endl;
+
+    const long maxKey = static_cast<long>(numKeys) * 16;
+    std::mt19937_64 rng(0);
+    std::uniform_int_distribution<long> distribution(0, maxKey);
+    std::vector<long> keys(numKeys);
+    for (auto &key : keys) {
+        key = distribution(rng);
+    }
+
+    // Half of the queries are stored keys, the rest are mostly misses
+    std::vector<long> queries(numLookups);
+    for (size_t ii = 0; ii < numLookups; ++ii) {
+        queries[ii] = ii % 2 ? keys[rng() % numKeys] : distribution(rng);
+    }
+
+    // Both stages predict key / maxKey, the CDF of uniform keys
+    const std::string weightPath = "find_batch_benchmark.weights";
+    FirstStageWeights firstStage;
+    firstStage.hiddenWeight = {1.0f};
+    firstStage.hiddenBias = {0.0f};
+    firstStage.outputWeight = {1.0f / maxKey};
+    std::vector<LinearModelWeights> secondStage(1024);
+    for (auto &model : secondStage) {
+        model.weight = 1.0f / maxKey;
+    }
+    if (!saveModelWeights(weightPath, firstStage, secondStage)) {
+        return 1;
+    }
+
+    benchmarkIndex("Model windows", keys, queries, weightPath, static_cast<int>(numKeys));
+    benchmarkIndex("B-trees", keys, queries, weightPath, 0);
+    std::remove(weightPath.c_str());
+    return 0;
+}
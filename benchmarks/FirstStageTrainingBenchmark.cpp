@@ -0,0 +1,90 @@
+/**
+ * @file FirstStageTrainingBenchmark.cpp
+ *
+ * @brief Build time and accuracy of multithreaded first stage training, by thread count and mode
+ *
+ * Usage: first_stage_training_benchmark [numKeys] [maxNumEpochs] [maxThreads]
+ *
+ * @date 10/19/2026
+ */
+
+#include "../src/FirstStageTrainer.h"
+#include <chrono>
+#include <random>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+/**
+ * @brief Train once and report time, iterations and the position error of the result
+ */
+void benchmarkTraining(const std::vector<float> &keys, const std::vector<float> &positions,
+                       const NetworkParameters &networkParams, const ParallelTrainingParameters &parallelParams) {
+    FirstStageTrainer trainer(networkParams, parallelParams);
+
+    auto startTime = std::chrono::steady_clock::now();
+    FirstStageWeights weights = trainer.train(keys.data(), positions.data(), keys.size(), keys.size());
+    auto endTime = std::chrono::steady_clock::now();
+
+    double errorSum = 0;
+    for (size_t ii = 0; ii < keys.size(); ++ii) {
+        errorSum += std::abs(weights.predict(keys[ii]) * keys.size() - positions[ii]);
+    }
+
+    std::chrono::duration<double, std::milli> duration = endTime - startTime;
+    std::cerr << (parallelParams.hogwild ? "Hogwild" : "Synchronous") << ", " << trainer.numThreads() << " threads, "
+              << (parallelParams.hogwild ? 1 : parallelParams.batchesPerStep) << " batches per step: "
+              << duration.count() << " ms, " << trainer.numIterations() << " iterations, mean position error "
+              << errorSum / keys.size() << std::endl;
+}
+
+int main(int argc, char **argv) {
+    size_t numKeys = argc > 1 ? std::stoull(argv[1]) : (1 << 20);
+    int maxNumEpochs = argc > 2 ? std::stoi(argv[2]) : 25000;
+    unsigned int maxThreads = argc > 3 ? std::stoul(argv[3]) : std::max(std::thread::hardware_concurrency(), 1u);
+
+    std::mt19937 rng(0);
+    std::lognormal_distribution<double> distribution(0, 1);
+    std::vector<float> keys(numKeys);
+    for (auto &key : keys) {
+        key = static_cast<float>(distribution(rng) * 1e6);
+    }
+    std::sort(keys.begin(), keys.end());
+    std::vector<float> positions(numKeys);
+    for (size_t ii = 0; ii < numKeys; ++ii) {
+        positions[ii] = static_cast<float>(ii);
+    }
+
+    NetworkParameters networkParams;
+    networkParams.batchSize = 256;
+    networkParams.maxNumEpochs = maxNumEpochs;
+    networkParams.learningRate = 0.01;
+    networkParams.numNeurons = 8;
+
+    // Training logs go to stdout, results to stderr
+    ParallelTrainingParameters parallelParams;
+    for (unsigned int numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+        parallelParams.numThreads = numThreads;
+        benchmarkTraining(keys, positions, networkParams, parallelParams);
+    }
+
+    // How much work between barriers pays for them. Without early stopping every run trains on the same batches
+    parallelParams.numThreads = maxThreads;
+    parallelParams.patience = 0;
+    for (int batchesPerStep : {1, 2, 4, 8, 16}) {
+        parallelParams.batchesPerStep = batchesPerStep;
+        benchmarkTraining(keys, positions, networkParams, parallelParams);
+    }
+    parallelParams = ParallelTrainingParameters();
+    parallelParams.numThreads = maxThreads;
+
+    parallelParams.hogwild = true;
+    benchmarkTraining(keys, positions, networkParams, parallelParams);
+
+    // Without early stopping, for reference
+    parallelParams.hogwild = false;
+    parallelParams.numThreads = 1;
+    parallelParams.patience = 0;
+    benchmarkTraining(keys, positions, networkParams, parallelParams);
+    return 0;
+}
@@ -0,0 +1,235 @@
+/**
+ * @file HugePageBenchmark.cpp
+ *
+ * @brief Measures what huge page backed storage and arena training buffers do for TLB misses and latency
+ *
+ * Usage: huge_page_benchmark [numKeys] [numLookups] [numIndexKeys]
+ *
+ * Raw lookups and training buffers run on numKeys keys. Whole indexes (training and batched lookups, with the
+ * sorted data on the heap and on huge pages) run on numIndexKeys keys, since training is much slower.
+ *
+ * dTLB miss counts come from perf_event_open, and print as n/a where perf counters aren't available
+ * (e.g. containers without perf access, or kernel.perf_event_paranoid too high).
+ *
+ * @date 10/18/2026
+ */
+
+#include "../src/RecursiveModelIndex.h"
+#include "../src/utils/Arena.h"
+#include "../src/utils/HugePageAllocator.h"
+#include <chrono>
+#include <random>
+#include <vector>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+/**
+ * @brief Counts dTLB load misses of this thread while alive
+ */
+class TlbMissCounter {
+public:
+    TlbMissCounter() {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        m_fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    ~TlbMissCounter() {
+        if (m_fd >= 0) {
+            close(m_fd);
+        }
+    }
+
+    bool isAvailable() const {
+        return m_fd >= 0;
+    }
+
+    void start() {
+        if (m_fd >= 0) {
+            ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    long long stop() {
+        long long count = 0;
+        if (m_fd >= 0) {
+            ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(m_fd, &count, sizeof(count)) != sizeof(count)) {
+                count = 0;
+            }
+        }
+        return count;
+    }
+
+private:
+    int m_fd;   ///< The perf event, or -1 if unavailable
+};
+
+/**
+ * @brief Time random lookups into sorted data, the access pattern of the last mile search on a large index
+ */
+template <typename Allocator>
+void benchmarkLookups(const std::string &name, size_t numKeys, size_t numLookups) {
+    typedef std::pair<long, long> Pair;
+    std::vector<Pair, Allocator> data;
+    data.reserve(numKeys);
+    for (size_t ii = 0; ii < numKeys; ++ii) {
+        data.push_back({static_cast<long>(ii * 3), static_cast<long>(ii)});
+    }
+
+    std::mt19937 rng(0);
+    std::uniform_int_distribution<size_t> distribution(0, numKeys - 1);
+    std::vector<long> queries(numLookups);
+    for (auto &query : queries) {
+        query = static_cast<long>(distribution(rng) * 3);
+    }
+
+    TlbMissCounter counter;
+    long checksum = 0;
+    auto startTime = std::chrono::steady_clock::now();
+    counter.start();
+    for (auto query : queries) {
+        auto result = std::lower_bound(data.begin(), data.end(), query, [](const Pair &pair, long key) {
+            return pair.first < key;
+        });
+        checksum += result->second;
+    }
+    long long tlbMisses = counter.stop();
+    auto endTime = std::chrono::steady_clock::now();
+
+    std::chrono::duration<double, std::nano> duration = endTime - startTime;
+    std::cout << name << " lookups: " << duration.count() / numLookups << " ns/lookup, dTLB misses/lookup: ";
+    if (counter.isAvailable()) {
+        std::cout << static_cast<double>(tlbMisses) / numLookups;
+    } else {
+        std::cout << "n/a";
+    }
+    std::cout << " (checksum " << checksum << ")" << std::endl;
+}
+
+/**
+ * @brief Time filling per stage training buffers, the way trainSecondStage does: count the keys of each stage,
+ * reserve exactly that, then fill
+ */
+template <typename MakeBuffers>
+void benchmarkTrainingBuffers(const std::string &name, size_t numKeys, MakeBuffers makeBuffers) {
+    const size_t numStages = 1024;
+
+    auto startTime = std::chrono::steady_clock::now();
+    {
+        std::vector<size_t> counts(numStages, 0);
+        for (size_t ii = 0; ii < numKeys; ++ii) {
+            counts[ii * numStages / numKeys]++;
+        }
+
+        auto buffers = makeBuffers(numStages);
+        for (size_t stage = 0; stage < numStages; ++stage) {
+            buffers[stage].reserve(counts[stage]);
+        }
+        for (size_t ii = 0; ii < numKeys; ++ii) {
+            buffers[ii * numStages / numKeys].push_back({static_cast<long>(ii), ii});
+        }
+    }
+    auto endTime = std::chrono::steady_clock::now();
+
+    std::chrono::duration<double, std::milli> duration = endTime - startTime;
+    std::cout << name << " training buffers: " << duration.count() << " ms" << std::endl;
+}
+
+/**
+ * @brief Time training a whole index and batched lookups on it, with the sorted data in Allocator's memory.
+ * Training buffers always come from the index's arena
+ */
+template <typename Allocator>
+void benchmarkIndex(const std::string &name, size_t numKeys, size_t numLookups) {
+    NetworkParameters firstStageParams;
+    firstStageParams.batchSize = 256;
+    firstStageParams.maxNumEpochs = 1000;
+    firstStageParams.learningRate = 0.01;
+    firstStageParams.numNeurons = 8;
+
+    NetworkParameters secondStageParams;
+    secondStageParams.batchSize = 64;
+    secondStageParams.maxNumEpochs = 100;
+    secondStageParams.learningRate = 0.01;
+
+    RecursiveModelIndex<long, long, 1024, Allocator> index(firstStageParams, secondStageParams, 256, numKeys);
+    std::mt19937_64 rng(0);
+    std::uniform_int_distribution<long> distribution(0, static_cast<long>(numKeys) * 16);
+    for (size_t ii = 0; ii < numKeys; ++ii) {
+        long key = distribution(rng);
+        index.insert(key, key + 1);
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+    index.train();
+    auto endTime = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::milli> trainDuration = endTime - startTime;
+
+    std::vector<long> queries(numLookups);
+    for (auto &query : queries) {
+        query = distribution(rng);
+    }
+    std::vector<boost::optional<std::pair<long, long>>> results;
+
+    TlbMissCounter counter;
+    startTime = std::chrono::steady_clock::now();
+    counter.start();
+    index.findBatch(queries, results);
+    long long tlbMisses = counter.stop();
+    endTime = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::nano> findDuration = endTime - startTime;
+
+    size_t numFound = std::count_if(results.begin(), results.end(), [](const boost::optional<std::pair<long, long>> &result) {
+        return static_cast<bool>(result);
+    });
+    std::cout << name << " index: train " << trainDuration.count() << " ms, find " << findDuration.count() / numLookups
+              << " ns/lookup, dTLB misses/lookup: ";
+    if (counter.isAvailable()) {
+        std::cout << static_cast<double>(tlbMisses) / numLookups;
+    } else {
+        std::cout << "n/a";
+    }
+    std::cout << " (found " << numFound << ")" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    size_t numKeys = argc > 1 ? std::stoull(argv[1]) : (1 << 25);
+    size_t numLookups = argc > 2 ? std::stoull(argv[2]) : (1 << 22);
+    size_t numIndexKeys = argc > 3 ? std::stoull(argv[3]) : (1 << 20);
+    std::cout << "Keys: " << numKeys << " Lookups: " << numLookups << " Index keys: " << numIndexKeys << std::endl;
+
+    benchmarkLookups<std::allocator<std::pair<long, long>>>("Heap", numKeys, numLookups);
+    benchmarkLookups<HugePageAllocator<std::pair<long, long>>>("Huge page", numKeys, numLookups);
+
+    typedef std::pair<long, size_t> TrainingPair;
+    benchmarkTrainingBuffers("Heap", numKeys, [](size_t numStages) {
+        return std::vector<std::vector<TrainingPair>>(numStages);
+    });
+
+    Arena arena;
+    benchmarkTrainingBuffers("Arena", numKeys, [&](size_t numStages) {
+        typedef std::vector<TrainingPair, ArenaAllocator<TrainingPair>> Buffer;
+        return std::vector<Buffer>(numStages, Buffer(ArenaAllocator<TrainingPair>(&arena)));
+    });
+    std::cout << "Arena handed out " << arena.bytesAllocated() << " bytes for " << numKeys * sizeof(TrainingPair)
+              << " bytes of keys" << std::endl;
+    arena.release();
+
+    benchmarkIndex<std::allocator<std::pair<long, long>>>("Heap", numIndexKeys, numLookups);
+    benchmarkIndex<HugePageAllocator<std::pair<long, long>>>("Huge page", numIndexKeys, numLookups);
+
+    return 0;
+}
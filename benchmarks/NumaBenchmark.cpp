@@ -0,0 +1,141 @@
+/**
+ * @file NumaBenchmark.cpp
+ *
+ * @brief Lookup throughput of a static index with one copy, versus NUMA replicated models and each data placement
+ *
+ * Usage: numa_benchmark [numKeys] [numLookups] [numNodes] [threadsPerNode]
+ *
+ * numNodes defaults to the machine's. Asking for more than the machine has emulates them (see utils/Numa.h),
+ * which exercises placement and pinning but can't show remote access costs, since every node is then equally close.
+ *
+ * @date 10/19/2026
+ */
+
+#include "../src/NumaReplicatedIndex.h"
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+typedef std::pair<long, long> Pair;
+typedef NumaReplicatedIndex<long, long, 16, 1 << 16> Index;
+
+/**
+ * @brief Run pinned workers over per node query lists and report the aggregate throughput
+ * @param queriesPerNode [in]: The queries the workers on each node split between them
+ * @param lookup [in]: lookup(key, node) returns the value found, 0 if none
+ */
+template <typename Lookup>
+void benchmarkWorkers(const std::string &name, const NumaTopology &topology, size_t threadsPerNode,
+                      const std::vector<std::vector<long>> &queriesPerNode, Lookup lookup) {
+    std::atomic<long> checksum(0);
+    size_t numLookups = 0;
+    for (const auto &queries : queriesPerNode) {
+        numLookups += queries.size();
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+    runPinnedWorkers(topology, threadsPerNode, [&](size_t node, size_t thread) {
+        const auto &queries = queriesPerNode[node];
+        long localChecksum = 0;
+        for (size_t ii = thread; ii < queries.size(); ii += threadsPerNode) {
+            localChecksum += lookup(queries[ii], node);
+        }
+        checksum += localChecksum;
+    });
+    auto endTime = std::chrono::steady_clock::now();
+
+    std::chrono::duration<double> duration = endTime - startTime;
+    std::cout << name << ": " << numLookups / duration.count() / 1e6 << " M lookups/s (checksum " << checksum << ")" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    size_t numKeys = argc > 1 ? std::stoull(argv[1]) : (1 << 24);
+    size_t numLookups = argc > 2 ? std::stoull(argv[2]) : (1 << 22);
+    NumaParameters params;
+    params.numNodes = argc > 3 ? std::stoull(argv[3]) : 0;
+    size_t threadsPerNode = argc > 4 ? std::stoull(argv[4]) : 1;
+
+    NumaTopology topology = NumaTopology::withNodes(params.numNodes);
+    std::cout << "Keys: " << numKeys << " Lookups: " << numLookups << " Nodes: " << topology.numNodes()
+              << (topology.isEmulated() ? " (emulated)" : "") << " Threads per node: " << threadsPerNode << std::endl;
+    for (size_t node = 0; node < topology.numNodes(); ++node) {
+        std::cout << "  node " << node << ": " << topology.cpus(node).size() << " CPUs, memory on node "
+                  << topology.memoryNode(node) << std::endl;
+    }
+
+    std::mt19937_64 rng(0);
+    std::lognormal_distribution<double> distribution(0, 2);
+    std::vector<Pair> data(numKeys);
+    for (size_t ii = 0; ii < numKeys; ++ii) {
+        data[ii].first = static_cast<long>(distribution(rng) * 1e9);
+    }
+    std::sort(data.begin(), data.end());
+    data.erase(std::unique(data.begin(), data.end()), data.end());
+    for (size_t ii = 0; ii < data.size(); ++ii) {
+        data[ii].second = static_cast<long>(ii);
+    }
+
+    // Stand in for a trained first stage: ReLU hinges at evenly spaced quantiles (as in StaticIndexBenchmark)
+    FirstStageWeights firstStage;
+    float previousSlope = 0;
+    for (size_t ii = 0; ii < 16; ++ii) {
+        size_t knot = ii * data.size() / 16;
+        size_t nextKnot = (ii + 1) * data.size() / 16 - 1;
+        float keyRange = std::max(1.0f, static_cast<float>(data[nextKnot].first - data[knot].first));
+        float slope = static_cast<float>(nextKnot - knot) / data.size() / keyRange;
+        firstStage.hiddenWeight.push_back(1.0f);
+        firstStage.hiddenBias.push_back(-static_cast<float>(data[knot].first));
+        firstStage.outputWeight.push_back(slope - previousSlope);
+        previousSlope = slope;
+    }
+
+    // Built by this thread, so with first touch placement its models and data all sit on one node
+    std::unique_ptr<Index::IndexType> staticIndex(new Index::IndexType());
+    if (!staticIndex->build(data, firstStage)) {
+        return 1;
+    }
+
+    // Every node looks up the same number of uniformly random keys
+    std::vector<std::vector<long>> queriesPerNode(topology.numNodes());
+    for (size_t ii = 0; ii < numLookups; ++ii) {
+        queriesPerNode[ii % topology.numNodes()].push_back(data[rng() % data.size()].first);
+    }
+
+    benchmarkWorkers("Single copy", topology, threadsPerNode, queriesPerNode, [&](long key, size_t) {
+        auto result = staticIndex->find(key);
+        return result ? result.get().second : 0;
+    });
+
+    for (auto placement : {NumaDataPlacement::Replicate, NumaDataPlacement::Interleave, NumaDataPlacement::Partition}) {
+        params.dataPlacement = placement;
+        Index index(params);
+        index.build(*staticIndex);
+
+        // Partitioned data is only local if each key goes to the node that owns it
+        auto nodeQueries = queriesPerNode;
+        std::string name = "Replicated models, replicated data";
+        if (placement == NumaDataPlacement::Interleave) {
+            name = "Replicated models, interleaved data";
+        } else if (placement == NumaDataPlacement::Partition) {
+            name = "Replicated models, partitioned data, keys routed to owner";
+            for (auto &queries : nodeQueries) {
+                queries.clear();
+            }
+            for (const auto &queries : queriesPerNode) {
+                for (long key : queries) {
+                    nodeQueries[index.ownerNode(key)].push_back(key);
+                }
+            }
+        }
+
+        benchmarkWorkers(name, topology, threadsPerNode, nodeQueries, [&](long key, size_t node) {
+            auto result = index.find(key, node);
+            return result ? result.get().second : 0;
+        });
+    }
+
+    return 0;
+}
@@ -0,0 +1,103 @@
+/**
+ * @file StaticIndexBenchmark.cpp
+ *
+ * @brief Lookup latency of the compile time specialized index against a plain binary search
+ *
+ * Usage: static_index_benchmark [numKeys] [numLookups]
+ *
+ * @date 10/18/2026
+ */
+
+#include "../src/StaticRecursiveModelIndex.h"
+#include <chrono>
+#include <memory>
+#include <random>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+typedef std::pair<long, long> Pair;
+
+/// Hidden width of the first stage
+const size_t numNeurons = 16;
+
+/**
+ * @brief Time a lookup function over the queries
+ */
+template <typename Lookup>
+void benchmarkLookups(const std::string &name, const std::vector<long> &queries, Lookup lookup) {
+    long checksum = 0;
+    auto startTime = std::chrono::steady_clock::now();
+    for (auto query : queries) {
+        checksum += lookup(query);
+    }
+    auto endTime = std::chrono::steady_clock::now();
+
+    std::chrono::duration<double, std::nano> duration = endTime - startTime;
+    std::cout << name << ": " << duration.count() / queries.size() << " ns/lookup (checksum " << checksum << ")" << std::endl;
+}
+
+/**
+ * @brief Build a static index with the given model and search strategy, and time lookups on it
+ */
+template <typename ModelType, typename SearchStrategy>
+void benchmarkStaticIndex(const std::string &name, const std::vector<Pair> &data, const FirstStageWeights &firstStage,
+                          const std::vector<long> &queries) {
+    typedef StaticRecursiveModelIndex<long, long, numNeurons, 1 << 16, ModelType, SearchStrategy> Index;
+    std::unique_ptr<Index> index(new Index());
+    if (!index->build(data, firstStage)) {
+        return;
+    }
+    benchmarkLookups(name, queries, [&](long query) {
+        auto result = index->find(query);
+        return result ? result.get().second : 0;
+    });
+}
+
+int main(int argc, char **argv) {
+    size_t numKeys = argc > 1 ? std::stoull(argv[1]) : (1 << 24);
+    size_t numLookups = argc > 2 ? std::stoull(argv[2]) : (1 << 22);
+    std::cout << "Keys: " << numKeys << " Lookups: " << numLookups << std::endl;
+
+    std::mt19937_64 rng(0);
+    std::lognormal_distribution<double> distribution(0, 2);
+    std::vector<Pair> data(numKeys);
+    for (size_t ii = 0; ii < numKeys; ++ii) {
+        data[ii].first = static_cast<long>(distribution(rng) * 1e9);
+    }
+    std::sort(data.begin(), data.end());
+    data.erase(std::unique(data.begin(), data.end()), data.end());
+    for (size_t ii = 0; ii < data.size(); ++ii) {
+        data[ii].second = static_cast<long>(ii);
+    }
+
+    std::vector<long> queries(numLookups);
+    for (auto &query : queries) {
+        query = data[rng() % data.size()].first;
+    }
+
+    // Stand in for a trained first stage: ReLU hinges at evenly spaced quantiles, which sum to a piecewise
+    // linear interpolation of the CDF
+    FirstStageWeights firstStage;
+    float previousSlope = 0;
+    for (size_t ii = 0; ii < numNeurons; ++ii) {
+        size_t knot = ii * data.size() / numNeurons;
+        size_t nextKnot = (ii + 1) * data.size() / numNeurons - 1;
+        float keyRange = std::max(1.0f, static_cast<float>(data[nextKnot].first - data[knot].first));
+        float slope = static_cast<float>(nextKnot - knot) / data.size() / keyRange;
+        firstStage.hiddenWeight.push_back(1.0f);
+        firstStage.hiddenBias.push_back(-static_cast<float>(data[knot].first));
+        firstStage.outputWeight.push_back(slope - previousSlope);
+        previousSlope = slope;
+    }
+
+    benchmarkLookups("std::lower_bound", queries, [&](long query) {
+        return std::lower_bound(data.begin(), data.end(), Pair(query, 0))->second;
+    });
+    benchmarkStaticIndex<LinearRegressionModel, BinarySearch>("Static, regression, binary search", data, firstStage, queries);
+    benchmarkStaticIndex<LinearRegressionModel, ExponentialSearch>("Static, regression, exponential search", data, firstStage, queries);
+    benchmarkStaticIndex<LinearSplineModel, BinarySearch>("Static, spline, binary search", data, firstStage, queries);
+    benchmarkStaticIndex<LinearSplineModel, ExponentialSearch>("Static, spline, exponential search", data, firstStage, queries);
+
+    return 0;
+}
@@ -0,0 +1,328 @@
+/**
+ * @file CompressedKeyArray.h
+ *
+ * @brief Frame of reference compressed storage for sorted integer keys
+ *
+ * @date 10/18/2026
+ */
+
+#ifndef LEARNED_INDICES_COMPRESSEDKEYARRAY_H
+#define LEARNED_INDICES_COMPRESSEDKEYARRAY_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * @brief Sorted integer keys stored as fixed width offsets from a per block base key
+ *
+ * Keys are split into blocks of BLOCK_SIZE consecutive positions. Each block stores its first key, and every
+ * key as an offset from it in the narrowest of 1, 2, 4 or 8 bytes that fits the block's range. Sorted keys
+ * over a narrow range (the common case inside a second stage node's error window) need 2-4x less memory
+ * than raw 64 bit keys. Searches compare the query's offset against the packed offsets directly with SSE2,
+ * so keys are never decoded on the search path.
+ *
+ * @tparam KeyType [in]: An integer key type
+ */
+template <typename KeyType>
+class CompressedKeyArray {
+    static_assert(std::is_integral<KeyType>::value, "Frame of reference encoding needs integer keys");
+
+public:
+    /// Number of keys sharing a base key
+    static const size_t BLOCK_SIZE = 128;
+
+    CompressedKeyArray(): m_size(0) {}
+
+    /**
+     * @brief Compress the keys of sorted (key, value) pairs
+     * @param data [in]: Pairs sorted by key
+     */
+    template <typename PairContainer>
+    void build(const PairContainer &data);
+
+    /**
+     * @brief Decode one key
+     * @param idx [in]: Position of the key
+     */
+    KeyType get(size_t idx) const {
+        const Block &block = m_blocks[idx / BLOCK_SIZE];
+        return static_cast<KeyType>(static_cast<uint64_t>(block.base) + loadOffset(block, idx % BLOCK_SIZE));
+    }
+
+    /**
+     * @brief Find the first position in [startIdx, endIdx) whose key is >= key
+     * @return The position, or endIdx if every key in the range is smaller
+     */
+    size_t lowerBound(size_t startIdx, size_t endIdx, KeyType key) const;
+
+    /**
+     * @brief Skip the blocks of [startIdx, endIdx) whose keys are all smaller than key, by binary search over the
+     * block base keys only. None of the packed offsets are read
+     * @return A position in [startIdx, endIdx) such that the lower bound of key is in the rest of its block, or
+     * at the start of the next block
+     */
+    size_t findBlockStart(size_t startIdx, size_t endIdx, KeyType key) const;
+
+    /**
+     * @param block [in]: A block number, position / BLOCK_SIZE
+     * @return The first key of the block
+     */
+    KeyType getBlockBase(size_t block) const {
+        return m_blocks[block].base;
+    }
+
+    /**
+     * @return The address of a block's base key and layout, for prefetching
+     */
+    const void *getBlockAddress(size_t block) const {
+        return &m_blocks[block];
+    }
+
+    /**
+     * @return The address of the packed offset at a position, for prefetching
+     */
+    const void *getAddress(size_t idx) const {
+        const Block &block = m_blocks[idx / BLOCK_SIZE];
+        return m_payload.data() + block.payloadOffset + (idx % BLOCK_SIZE) * block.width;
+    }
+
+    /**
+     * @return Number of keys stored
+     */
+    size_t size() const {
+        return m_size;
+    }
+
+    /**
+     * @return Bytes used by the compressed keys
+     */
+    size_t memoryUsage() const {
+        return m_blocks.size() * sizeof(Block) + m_payload.size();
+    }
+
+    /**
+     * @brief Free all the keys
+     */
+    void clear() {
+        m_blocks = std::vector<Block>();
+        m_payload = std::vector<uint8_t>();
+        m_size = 0;
+    }
+
+private:
+    struct Block {
+        KeyType base;               ///< First key of the block, all offsets are relative to it
+        uint64_t payloadOffset;     ///< Where the block's offsets start in m_payload
+        uint8_t width;              ///< Bytes per offset: 1, 2, 4 or 8
+    };
+
+    /**
+     * @brief Read the offset at a position in a block
+     */
+    uint64_t loadOffset(const Block &block, size_t position) const {
+        const uint8_t *address = m_payload.data() + block.payloadOffset + position * block.width;
+        switch (block.width) {
+            case 1: return *address;
+            case 2: { uint16_t offset; std::memcpy(&offset, address, 2); return offset; }
+            case 4: { uint32_t offset; std::memcpy(&offset, address, 4); return offset; }
+            default: { uint64_t offset; std::memcpy(&offset, address, 8); return offset; }
+        }
+    }
+
+    /**
+     * @brief Count how many of the offsets at [position, position + count) of a block are smaller than delta.
+     * The offsets are sorted, so this stops at the first vector holding one that isn't
+     */
+    size_t countLess(const Block &block, size_t position, size_t count, uint64_t delta) const;
+
+    std::vector<Block> m_blocks;    ///< Base key and layout of every block
+    std::vector<uint8_t> m_payload; ///< The packed offsets of every block, back to back
+    size_t m_size;                  ///< Number of keys stored
+};
+
+template <typename KeyType>
+template <typename PairContainer>
+void CompressedKeyArray<KeyType>::build(const PairContainer &data) {
+    m_size = data.size();
+    m_blocks.clear();
+    m_payload.clear();
+
+    for (size_t start = 0; start < data.size(); start += BLOCK_SIZE) {
+        size_t end = std::min(start + BLOCK_SIZE, data.size());
+
+        Block block;
+        block.base = data[start].first;
+        block.payloadOffset = m_payload.size();
+
+        // Unsigned arithmetic keeps the difference exact for signed keys too
+        uint64_t range = static_cast<uint64_t>(data[end - 1].first) - static_cast<uint64_t>(block.base);
+        block.width = range <= UINT8_MAX ? 1 : range <= UINT16_MAX ? 2 : range <= UINT32_MAX ? 4 : 8;
+
+        m_payload.resize(m_payload.size() + (end - start) * block.width);
+        uint8_t *address = m_payload.data() + block.payloadOffset;
+        for (size_t ii = start; ii < end; ++ii) {
+            uint64_t offset = static_cast<uint64_t>(data[ii].first) - static_cast<uint64_t>(block.base);
+            // Little endian, so the low bytes of the offset are the narrow offset
+            std::memcpy(address, &offset, block.width);
+            address += block.width;
+        }
+        m_blocks.push_back(block);
+    }
+    m_payload.shrink_to_fit();
+}
+
+template <typename KeyType>
+size_t CompressedKeyArray<KeyType>::lowerBound(size_t startIdx, size_t endIdx, KeyType key) const {
+    // At most the rest of one block is compared, plus the base of the next
+    size_t idx = findBlockStart(startIdx, endIdx, key);
+    while (idx < endIdx) {
+        const Block &block = m_blocks[idx / BLOCK_SIZE];
+        size_t position = idx % BLOCK_SIZE;
+        size_t count = std::min(BLOCK_SIZE - position, endIdx - idx);
+
+        // Every key in the block is >= base
+        if (key <= block.base) {
+            return idx;
+        }
+
+        uint64_t delta = static_cast<uint64_t>(key) - static_cast<uint64_t>(block.base);
+        size_t numLess = count;
+        if (block.width == 8 || delta <= (1ULL << (8 * block.width)) - 1) {
+            numLess = countLess(block, position, count, delta);
+        }
+
+        if (numLess < count) {
+            return idx + numLess;
+        }
+        idx += count;
+    }
+    return endIdx;
+}
+
+template <typename KeyType>
+size_t CompressedKeyArray<KeyType>::findBlockStart(size_t startIdx, size_t endIdx, KeyType key) const {
+    if (startIdx >= endIdx) {
+        return startIdx;
+    }
+
+    // Find the last block after the first whose base is smaller than key, every block before it is all smaller
+    size_t low = startIdx / BLOCK_SIZE;
+    size_t high = (endIdx - 1) / BLOCK_SIZE;
+    while (low < high) {
+        size_t mid = low + (high - low + 1) / 2;
+        if (m_blocks[mid].base < key) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return std::max(startIdx, low * BLOCK_SIZE);
+}
+
+template <typename KeyType>
+size_t CompressedKeyArray<KeyType>::countLess(const Block &block, size_t position, size_t count, uint64_t delta) const {
+    const uint8_t *address = m_payload.data() + block.payloadOffset + position * block.width;
+    size_t numLess = 0;
+    size_t ii = 0;
+
+#ifdef __SSE2__
+    // SSE2 only has signed compares, so flip the sign bit of both sides to compare unsigned
+    if (block.width == 1) {
+        const __m128i sign = _mm_set1_epi8(static_cast<char>(0x80));
+        const __m128i query = _mm_xor_si128(_mm_set1_epi8(static_cast<char>(delta)), sign);
+        for (; ii + 16 <= count; ii += 16) {
+            __m128i offsets = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(address + ii)), sign);
+            int mask = _mm_movemask_epi8(_mm_cmplt_epi8(offsets, query));
+            numLess += __builtin_popcount(mask);
+            if (mask != 0xFFFF) {
+                return numLess;
+            }
+        }
+    } else if (block.width == 2) {
+        const __m128i sign = _mm_set1_epi16(static_cast<short>(0x8000));
+        const __m128i query = _mm_xor_si128(_mm_set1_epi16(static_cast<short>(delta)), sign);
+        for (; ii + 8 <= count; ii += 8) {
+            __m128i offsets = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(address + ii * 2)), sign);
+            int mask = _mm_movemask_epi8(_mm_cmplt_epi16(offsets, query));
+            numLess += __builtin_popcount(mask) / 2;
+            if (mask != 0xFFFF) {
+                return numLess;
+            }
+        }
+    } else if (block.width == 4) {
+        const __m128i sign = _mm_set1_epi32(static_cast<int>(0x80000000));
+        const __m128i query = _mm_xor_si128(_mm_set1_epi32(static_cast<int>(delta)), sign);
+        for (; ii + 4 <= count; ii += 4) {
+            __m128i offsets = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(address + ii * 4)), sign);
+            int mask = _mm_movemask_epi8(_mm_cmplt_epi32(offsets, query));
+            numLess += __builtin_popcount(mask) / 4;
+            if (mask != 0xFFFF) {
+                return numLess;
+            }
+        }
+    }
+#endif
+
+    for (; ii < count && loadOffset(block, position + ii) < delta; ++ii) {
+        numLess++;
+    }
+    return numLess;
+}
+
+/**
+ * @brief Stands in for CompressedKeyArray when keys aren't integers, so indexes over such keys still compile.
+ * It never holds keys: RecursiveModelIndex rejects enableCompressedKeys() at compile time for them
+ * @tparam KeyType [in]: A non integer key type
+ */
+template <typename KeyType>
+class EmptyKeyArray {
+public:
+    static const size_t BLOCK_SIZE = 1;
+
+    template <typename PairContainer>
+    void build(const PairContainer &) {}
+
+    KeyType get(size_t) const {
+        return KeyType();
+    }
+
+    size_t lowerBound(size_t, size_t endIdx, KeyType) const {
+        return endIdx;
+    }
+
+    KeyType getBlockBase(size_t) const {
+        return KeyType();
+    }
+
+    const void *getBlockAddress(size_t) const {
+        return nullptr;
+    }
+
+    const void *getAddress(size_t) const {
+        return nullptr;
+    }
+
+    size_t size() const {
+        return 0;
+    }
+
+    size_t memoryUsage() const {
+        return 0;
+    }
+
+    void clear() {}
+};
+
+/// Compressed storage for a key type: a CompressedKeyArray for integer keys, an EmptyKeyArray otherwise
+template <typename KeyType>
+using CompressedKeyStorage = typename std::conditional<std::is_integral<KeyType>::value,
+                                                       CompressedKeyArray<KeyType>, EmptyKeyArray<KeyType>>::type;
+
+#endif //LEARNED_INDICES_COMPRESSEDKEYARRAY_H
@@ -0,0 +1,526 @@
+/**
+ * @file FirstStageTrainer.h
+ *
+ * @brief Multithreaded training of the first stage network, with early stopping
+ *
+ * @date 10/19/2026
+ */
+
+#ifndef LEARNED_INDICES_FIRSTSTAGETRAINER_H
+#define LEARNED_INDICES_FIRSTSTAGETRAINER_H
+
+#include "utils/DataUtils.h"
+#include "utils/ModelWeights.h"
+#include "utils/NetworkParameters.h"
+#include <cmath>
+#include <atomic>
+#include <limits>
+#include <thread>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+/**
+ * @brief A barrier that spins (yielding) instead of sleeping, since training iterations are only microseconds long
+ */
+class SpinBarrier {
+public:
+    explicit SpinBarrier(size_t numThreads): m_numThreads(numThreads), m_numWaiting(0), m_generation(0) {}
+
+    /**
+     * @brief Block until all numThreads threads have called wait
+     */
+    void wait() {
+        size_t generation = m_generation.load(std::memory_order_acquire);
+        if (m_numWaiting.fetch_add(1, std::memory_order_acq_rel) + 1 == m_numThreads) {
+            m_numWaiting.store(0, std::memory_order_relaxed);
+            m_generation.fetch_add(1, std::memory_order_release);
+            return;
+        }
+        while (m_generation.load(std::memory_order_acquire) == generation) {
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    size_t m_numThreads;                ///< Threads that must arrive before any leaves
+    std::atomic<size_t> m_numWaiting;   ///< Threads that arrived in the current generation
+    std::atomic<size_t> m_generation;   ///< Bumped each time every thread has arrived
+};
+
+/**
+ * @brief Trains the first stage (Dense -> ReLU -> Dense) on every core, with explicit forward and backward passes
+ *
+ * In the default synchronous mode each thread computes gradients on batchesPerStep of its own batches of batchSize
+ * keys, the gradients are averaged, and one Adam step is taken, so every iteration sees numThreads * batchesPerStep
+ * batches. Every step costs two trips through the barrier and a serial reduction, which a single small batch does
+ * not pay for. maxNumEpochs still counts batches per thread, so there are fewer, larger steps. In Hogwild mode
+ * threads run their own Adam steps on shared weights with no locking at all.
+ *
+ * Training stops early once the mean loss over convergenceWindow iterations has failed to improve for patience
+ * windows in a row. Keys are normalized internally and the normalization is folded back into the returned
+ * weights, so they evaluate raw keys like any other FirstStageWeights.
+ */
+class FirstStageTrainer {
+public:
+
+    /**
+     * @brief Create a trainer
+     * @param networkParams [in]: Batch size (per thread), max iterations, learning rate, width and seed
+     * @param parallelParams [in]: Threading mode and convergence criteria
+     */
+    FirstStageTrainer(const NetworkParameters &networkParams, const ParallelTrainingParameters &parallelParams);
+
+    /**
+     * @brief Train on (key, position) samples
+     * @param keys [in]: The sample keys, sorted
+     * @param positions [in]: Position of each sample key in the whole dataset
+     * @param numSamples [in]: Number of samples, at least batchSize
+     * @param datasetSize [in]: The size of the WHOLE dataset
+     * @return The trained weights, predicting position / datasetSize. All zero when there are no samples
+     */
+    FirstStageWeights train(const float *keys, const float *positions, size_t numSamples, size_t datasetSize);
+
+    /**
+     * @return Iterations run by the last train(), less than maxNumEpochs if it stopped early
+     */
+    size_t numIterations() const {
+        return m_numIterations;
+    }
+
+    /**
+     * @return Mean loss of the last iteration of the last train()
+     */
+    float finalLoss() const {
+        return m_finalLoss;
+    }
+
+    /**
+     * @return Number of threads training runs on
+     */
+    unsigned int numThreads() const {
+        return m_numThreads;
+    }
+
+private:
+
+    struct AdamState {
+        std::vector<float> firstMoment;     ///< Running mean of the gradient
+        std::vector<float> secondMoment;    ///< Running mean of the squared gradient
+        size_t numSteps = 0;                ///< Steps taken, for bias correction
+    };
+
+    /**
+     * @brief Tracks the windowed mean loss and decides when it has plateaued
+     */
+    class ConvergenceMonitor {
+    public:
+        explicit ConvergenceMonitor(const ParallelTrainingParameters &params):
+            m_params(params), m_windowLoss(0), m_windowSize(0),
+            m_bestLoss(std::numeric_limits<double>::infinity()), m_numPlateaued(0), m_numDecays(0),
+            m_learningRateScale(1) {}
+
+        /**
+         * @brief Record one iteration's loss. A plateau first cuts the learning rate (Adam's fixed step size
+         * otherwise leaves the model jittering around the optimum), up to maxNumDecays times, then stops training
+         * @return Whether training should stop
+         */
+        bool update(size_t iteration, float loss) {
+            m_windowLoss += loss;
+            if (++m_windowSize < std::max(m_params.convergenceWindow, 1)) {
+                return false;
+            }
+
+            double meanLoss = m_windowLoss / m_windowSize;
+            m_windowLoss = 0;
+            m_windowSize = 0;
+            std::cout << "Iteration: " << iteration << " Loss: " << meanLoss << std::endl;
+
+            if (meanLoss < m_bestLoss * (1 - m_params.minImprovement)) {
+                m_bestLoss = meanLoss;
+                m_numPlateaued = 0;
+            } else {
+                m_numPlateaued++;
+            }
+            if (m_params.patience <= 0 || m_numPlateaued < m_params.patience) {
+                return false;
+            }
+            if (m_numDecays >= m_params.maxNumDecays) {
+                return true;
+            }
+            m_numDecays++;
+            m_numPlateaued = 0;
+            m_learningRateScale *= m_params.learningRateDecay;
+            return false;
+        }
+
+        /**
+         * @return What the learning rate is multiplied by, after decays
+         */
+        float learningRateScale() const {
+            return m_learningRateScale;
+        }
+
+    private:
+        ParallelTrainingParameters m_params;    ///< Window size and thresholds
+        double m_windowLoss;                    ///< Sum of losses in the current window
+        int m_windowSize;                       ///< Iterations in the current window
+        double m_bestLoss;                      ///< Best window mean so far
+        int m_numPlateaued;                     ///< Windows in a row without enough improvement
+        int m_numDecays;                        ///< Times the learning rate was cut
+        float m_learningRateScale;              ///< Product of the decays so far
+    };
+
+    /**
+     * @brief Forward and backward pass over one batch
+     * @param weights [in]: Current parameters
+     * @param sampler [in]: Where to draw the batch from
+     * @param gradient [out]: Gradient of the mean Huber loss
+     * @return The mean Huber loss of the batch
+     */
+    float computeGradient(const std::vector<float> &weights, BatchSampler &sampler, std::vector<float> &gradient) const;
+
+    /**
+     * @brief Compute an Adam update
+     * @param gradient [in]: The gradient to step along
+     * @param learningRate [in]: Step size
+     * @param state [in]: Moments of this optimizer, updated
+     * @param update [out]: The amount to subtract from each parameter
+     */
+    void computeAdamUpdate(const std::vector<float> &gradient, float learningRate, AdamState &state,
+                           std::vector<float> &update) const;
+
+    /**
+     * @brief Initialize from the data instead of at random. Random hinges mostly land in the bulk of the keys, and
+     * the sign-like Huber gradient rarely moves dead units back, so random starts get stuck far from the CDF
+     */
+    std::vector<float> initializeWeights() const;
+
+    /**
+     * @brief Fold the key normalization into the parameters
+     */
+    FirstStageWeights toFirstStageWeights(const std::vector<float> &weights) const;
+
+    /**
+     * @brief Train with averaged gradients, one Adam step per iteration
+     */
+    std::vector<float> trainSynchronous();
+
+    /**
+     * @brief Train with every thread stepping the shared weights without locks
+     */
+    std::vector<float> trainHogwild();
+
+    size_t numParameters() const {
+        return 3 * m_numNeurons + 1;
+    }
+
+    NetworkParameters m_networkParams;          ///< Batch size, iterations, learning rate, width and seed
+    ParallelTrainingParameters m_parallelParams;///< Threading mode and convergence criteria
+    unsigned int m_numThreads;                  ///< Threads we train on
+    size_t m_numNeurons;                        ///< Hidden width
+
+    const float *m_keys;                        ///< Sample keys of the current train()
+    const float *m_positions;                   ///< Sample positions of the current train()
+    size_t m_numSamples;                        ///< Number of samples of the current train()
+    float m_datasetSize;                        ///< Size of the whole dataset
+    double m_keyMean;                           ///< Mean sample key
+    double m_keyScale;                          ///< Standard deviation of the sample keys
+
+    size_t m_numIterations;                     ///< Iterations run by the last train()
+    float m_finalLoss;                          ///< Loss of the last iteration
+};
+
+inline FirstStageTrainer::FirstStageTrainer(const NetworkParameters &networkParams,
+                                            const ParallelTrainingParameters &parallelParams):
+    m_networkParams(networkParams), m_parallelParams(parallelParams),
+    m_numNeurons(static_cast<size_t>(networkParams.numNeurons)), m_keys(nullptr), m_positions(nullptr),
+    m_numSamples(0), m_datasetSize(1), m_keyMean(0), m_keyScale(1), m_numIterations(0), m_finalLoss(0)
+{
+    m_numThreads = parallelParams.numThreads > 0 ? parallelParams.numThreads : std::thread::hardware_concurrency();
+    m_numThreads = std::max(m_numThreads, 1u);
+}
+
+inline FirstStageWeights FirstStageTrainer::train(const float *keys, const float *positions, size_t numSamples,
+                                                  size_t datasetSize) {
+    m_keys = keys;
+    m_positions = positions;
+    m_numSamples = numSamples;
+    m_datasetSize = static_cast<float>(datasetSize);
+    m_numIterations = 0;
+    m_finalLoss = 0;
+    if (numSamples == 0) {
+        std::cerr << "No samples to train the first stage on" << std::endl;
+        m_keyMean = 0;
+        m_keyScale = 1;
+        return toFirstStageWeights(std::vector<float>(numParameters(), 0.0f));
+    }
+
+    // Raw keys can be in the billions, normalizing them keeps the optimization well conditioned
+    double sum = 0, squaredSum = 0;
+    for (size_t ii = 0; ii < numSamples; ++ii) {
+        sum += keys[ii];
+        squaredSum += static_cast<double>(keys[ii]) * keys[ii];
+    }
+    m_keyMean = sum / std::max(numSamples, static_cast<size_t>(1));
+    double variance = squaredSum / std::max(numSamples, static_cast<size_t>(1)) - m_keyMean * m_keyMean;
+    m_keyScale = variance > 0 ? std::sqrt(variance) : 1;
+
+    std::cout << "Training first stage on " << m_numThreads << " threads"
+              << (m_parallelParams.hogwild ? " (Hogwild)" : "") << std::endl;
+    std::vector<float> weights = m_parallelParams.hogwild ? trainHogwild() : trainSynchronous();
+    return toFirstStageWeights(weights);
+}
+
+inline float FirstStageTrainer::computeGradient(const std::vector<float> &weights, BatchSampler &sampler,
+                                                std::vector<float> &gradient) const {
+    // Huber threshold, in positions
+    const float delta = 1.0f;
+    const size_t numNeurons = m_numNeurons;
+    const float *hiddenWeight = weights.data();
+    const float *hiddenBias = hiddenWeight + numNeurons;
+    const float *outputWeight = hiddenBias + numNeurons;
+    const float outputBias = outputWeight[numNeurons];
+
+    std::fill(gradient.begin(), gradient.end(), 0.0f);
+    float *hiddenWeightGradient = gradient.data();
+    float *hiddenBiasGradient = hiddenWeightGradient + numNeurons;
+    float *outputWeightGradient = hiddenBiasGradient + numNeurons;
+    float &outputBiasGradient = outputWeightGradient[numNeurons];
+
+    const float inverseKeyScale = static_cast<float>(1 / m_keyScale);
+    const float keyMean = static_cast<float>(m_keyMean);
+    const auto &batch = sampler.nextBatch();
+    const float inverseBatchSize = 1.0f / batch.size();
+
+    double lossSum = 0;
+    for (size_t idx : batch) {
+        const float input = (m_keys[idx] - keyMean) * inverseKeyScale;
+
+        float output = outputBias;
+        for (size_t jj = 0; jj < numNeurons; ++jj) {
+            output += outputWeight[jj] * std::max(0.0f, hiddenWeight[jj] * input + hiddenBias[jj]);
+        }
+
+        // As in trainFirstStage, the loss is on positions: output scaled by the dataset size. Adam is scale
+        // invariant, so we step along the clipped residual without the dataset size factor
+        const float residual = output * m_datasetSize - m_positions[idx];
+        const float absResidual = std::abs(residual);
+        lossSum += absResidual <= delta ? 0.5f * residual * residual : delta * (absResidual - 0.5f * delta);
+        const float outputGradient = std::max(-delta, std::min(delta, residual)) * inverseBatchSize;
+
+        outputBiasGradient += outputGradient;
+        for (size_t jj = 0; jj < numNeurons; ++jj) {
+            const float hidden = hiddenWeight[jj] * input + hiddenBias[jj];
+            if (hidden > 0) {
+                outputWeightGradient[jj] += outputGradient * hidden;
+                const float hiddenGradient = outputGradient * outputWeight[jj];
+                hiddenBiasGradient[jj] += hiddenGradient;
+                hiddenWeightGradient[jj] += hiddenGradient * input;
+            }
+        }
+    }
+    return static_cast<float>(lossSum / batch.size());
+}
+
+inline void FirstStageTrainer::computeAdamUpdate(const std::vector<float> &gradient, float learningRate,
+                                                 AdamState &state, std::vector<float> &update) const {
+    const float beta1 = 0.9f, beta2 = 0.999f, epsilon = 1e-8f;
+    if (state.firstMoment.empty()) {
+        state.firstMoment.assign(gradient.size(), 0.0f);
+        state.secondMoment.assign(gradient.size(), 0.0f);
+    }
+
+    state.numSteps++;
+    const float stepSize = learningRate *
+                           std::sqrt(1 - std::pow(beta2, static_cast<float>(state.numSteps))) /
+                           (1 - std::pow(beta1, static_cast<float>(state.numSteps)));
+    for (size_t ii = 0; ii < gradient.size(); ++ii) {
+        state.firstMoment[ii] = beta1 * state.firstMoment[ii] + (1 - beta1) * gradient[ii];
+        state.secondMoment[ii] = beta2 * state.secondMoment[ii] + (1 - beta2) * gradient[ii] * gradient[ii];
+        update[ii] = stepSize * state.firstMoment[ii] / (std::sqrt(state.secondMoment[ii]) + epsilon);
+    }
+}
+
+inline std::vector<float> FirstStageTrainer::initializeWeights() const {
+    std::vector<float> weights(numParameters(), 0.0f);
+    if (m_numSamples == 0) {
+        return weights;
+    }
+    auto normalizedKey = [&](size_t idx) {
+        return static_cast<float>((m_keys[idx] - m_keyMean) / m_keyScale);
+    };
+
+    // Hidden unit jj hinges at the jj-th of numNeurons evenly spaced quantiles, and its output weight is the
+    // change in slope there, so the network starts out as the piecewise linear interpolation of the CDF
+    float previousSlope = 0;
+    for (size_t jj = 0; jj < m_numNeurons; ++jj) {
+        size_t knot = jj * m_numSamples / m_numNeurons;
+        size_t nextKnot = std::min((jj + 1) * m_numSamples / m_numNeurons, m_numSamples - 1);
+        float keyRange = normalizedKey(nextKnot) - normalizedKey(knot);
+        float positionRange = (m_positions[nextKnot] - m_positions[knot]) / m_datasetSize;
+        float slope = keyRange > 0 ? positionRange / keyRange : previousSlope;
+
+        weights[jj] = 1.0f;
+        weights[m_numNeurons + jj] = -normalizedKey(knot);
+        weights[2 * m_numNeurons + jj] = slope - previousSlope;
+        previousSlope = slope;
+    }
+    weights[3 * m_numNeurons] = m_positions[0] / m_datasetSize;
+    return weights;
+}
+
+inline FirstStageWeights FirstStageTrainer::toFirstStageWeights(const std::vector<float> &weights) const {
+    // w * (key - mean) / scale + b == (w / scale) * key + (b - w * mean / scale)
+    FirstStageWeights firstStage;
+    for (size_t jj = 0; jj < m_numNeurons; ++jj) {
+        double hiddenWeight = weights[jj] / m_keyScale;
+        firstStage.hiddenWeight.push_back(static_cast<float>(hiddenWeight));
+        firstStage.hiddenBias.push_back(static_cast<float>(weights[m_numNeurons + jj] - hiddenWeight * m_keyMean));
+        firstStage.outputWeight.push_back(weights[2 * m_numNeurons + jj]);
+    }
+    firstStage.outputBias = weights[3 * m_numNeurons];
+    return firstStage;
+}
+
+inline std::vector<float> FirstStageTrainer::trainSynchronous() {
+    std::vector<float> weights = initializeWeights();
+    std::vector<std::vector<float>> gradients(m_numThreads, std::vector<float>(numParameters()));
+    std::vector<float> losses(m_numThreads);
+    std::vector<float> update(numParameters());
+    AdamState adam;
+    ConvergenceMonitor monitor(m_parallelParams);
+    SpinBarrier barrier(m_numThreads);
+    std::atomic<bool> stop(false);
+
+    const size_t batchesPerStep = static_cast<size_t>(std::max(m_parallelParams.batchesPerStep, 1));
+
+    auto worker = [&](unsigned int thread) {
+        // Every thread draws its own batches
+        BatchSampler sampler(m_networkParams.batchSize, m_numSamples, m_networkParams.seed + thread,
+                             m_networkParams.fullPassEpochs);
+        const size_t maxIterations = std::max(m_networkParams.maxNumEpochs * sampler.batchesPerEpoch() / batchesPerStep,
+                                              static_cast<size_t>(1));
+        std::vector<float> batchGradient(numParameters());
+
+        for (size_t iteration = 0; iteration < maxIterations; ++iteration) {
+            // Sum several batches before meeting the other threads, the reduction averages them
+            losses[thread] = computeGradient(weights, sampler, gradients[thread]);
+            for (size_t batch = 1; batch < batchesPerStep; ++batch) {
+                losses[thread] += computeGradient(weights, sampler, batchGradient);
+                for (size_t ii = 0; ii < numParameters(); ++ii) {
+                    gradients[thread][ii] += batchGradient[ii];
+                }
+            }
+            barrier.wait();
+
+            // One thread reduces and steps while the rest wait, the model is far too small to split the step
+            if (thread == 0) {
+                for (unsigned int other = 1; other < m_numThreads; ++other) {
+                    for (size_t ii = 0; ii < numParameters(); ++ii) {
+                        gradients[0][ii] += gradients[other][ii];
+                    }
+                }
+                for (auto &gradient : gradients[0]) {
+                    gradient /= m_numThreads * batchesPerStep;
+                }
+                computeAdamUpdate(gradients[0], m_networkParams.learningRate * monitor.learningRateScale(), adam, update);
+                for (size_t ii = 0; ii < numParameters(); ++ii) {
+                    weights[ii] -= update[ii];
+                }
+
+                float loss = 0;
+                for (auto threadLoss : losses) {
+                    loss += threadLoss / (m_numThreads * batchesPerStep);
+                }
+                m_numIterations = iteration + 1;
+                m_finalLoss = loss;
+                if (monitor.update(iteration, loss)) {
+                    stop.store(true, std::memory_order_relaxed);
+                }
+            }
+            barrier.wait();
+
+            if (stop.load(std::memory_order_relaxed)) {
+                break;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned int thread = 1; thread < m_numThreads; ++thread) {
+        threads.emplace_back(worker, thread);
+    }
+    worker(0);
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    return weights;
+}
+
+inline std::vector<float> FirstStageTrainer::trainHogwild() {
+    std::vector<float> initialWeights = initializeWeights();
+    std::vector<std::atomic<float>> sharedWeights(numParameters());
+    for (size_t ii = 0; ii < numParameters(); ++ii) {
+        sharedWeights[ii].store(initialWeights[ii], std::memory_order_relaxed);
+    }
+    ConvergenceMonitor monitor(m_parallelParams);
+    std::atomic<bool> stop(false);
+    std::atomic<float> learningRateScale(1.0f);
+
+    auto worker = [&](unsigned int thread) {
+        BatchSampler sampler(m_networkParams.batchSize, m_numSamples, m_networkParams.seed + thread,
+                             m_networkParams.fullPassEpochs);
+        const size_t maxIterations = m_networkParams.maxNumEpochs * sampler.batchesPerEpoch();
+        std::vector<float> weights(numParameters());
+        std::vector<float> gradient(numParameters());
+        std::vector<float> update(numParameters());
+        AdamState adam;
+
+        for (size_t iteration = 0; iteration < maxIterations && !stop.load(std::memory_order_relaxed); ++iteration) {
+            for (size_t ii = 0; ii < numParameters(); ++ii) {
+                weights[ii] = sharedWeights[ii].load(std::memory_order_relaxed);
+            }
+            float loss = computeGradient(weights, sampler, gradient);
+            computeAdamUpdate(gradient, m_networkParams.learningRate * learningRateScale.load(std::memory_order_relaxed),
+                              adam, update);
+
+            // Racing updates may overwrite each other, which Hogwild accepts in exchange for never waiting
+            for (size_t ii = 0; ii < numParameters(); ++ii) {
+                sharedWeights[ii].store(sharedWeights[ii].load(std::memory_order_relaxed) - update[ii],
+                                        std::memory_order_relaxed);
+            }
+
+            // Thread 0 speaks for everyone on convergence
+            if (thread == 0) {
+                m_numIterations = iteration + 1;
+                m_finalLoss = loss;
+                if (monitor.update(iteration, loss)) {
+                    stop.store(true, std::memory_order_relaxed);
+                }
+                learningRateScale.store(monitor.learningRateScale(), std::memory_order_relaxed);
+            }
+        }
+        // Nothing left to wait on once thread 0 is done
+        if (thread == 0) {
+            stop.store(true, std::memory_order_relaxed);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned int thread = 1; thread < m_numThreads; ++thread) {
+        threads.emplace_back(worker, thread);
+    }
+    worker(0);
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    std::vector<float> weights(numParameters());
+    for (size_t ii = 0; ii < numParameters(); ++ii) {
+        weights[ii] = sharedWeights[ii].load(std::memory_order_relaxed);
+    }
+    return weights;
+}
+
+#endif //LEARNED_INDICES_FIRSTSTAGETRAINER_H
@@ -0,0 +1,301 @@
+/**
+ * @file GappedArray.h
+ *
+ * @brief An updatable, model-placed leaf for the second stage of a recursive index
+ *
+ * @date 10/18/2026
+ */
+
+#ifndef LEARNED_INDICES_GAPPEDARRAY_H
+#define LEARNED_INDICES_GAPPEDARRAY_H
+
+#include <vector>
+#include <limits>
+#include <cstddef>
+#include <algorithm>
+#include <boost/optional.hpp>
+
+/**
+ * @brief A container for the parameters of gapped array leaves
+ */
+struct GappedLeafParameters {
+    float initialDensity = 0.7;     ///< Fraction of slots holding keys right after a (re)build
+    float maxDensity = 0.8;         ///< Density at which a leaf expands back to initialDensity
+    size_t maxLeafSize = 1 << 16;   ///< Number of keys at which a leaf splits in two
+    int maxPredictionError = 32;    ///< Inserts landing further than this from the predicted slot count as mispredicted
+    size_t minRefitInserts = 64;    ///< Inserts since the last rebuild before mispredictions can trigger a refit
+};
+
+/**
+ * @brief A sorted array with gaps, where keys sit near the slot a linear model predicts for them (as in ALEX)
+ *
+ * Gaps hold a copy of the next key to their right, so the key array is always non decreasing and can be
+ * searched directly. Inserts shift keys to the nearest gap, and the array rebuilds itself (refitting the
+ * model) when it gets too dense, or when over a quarter of the inserts since the last rebuild landed far from
+ * their predicted slot (checked once there were at least minRefitInserts of them).
+ *
+ * @tparam KeyType [in]: Key type of the leaf
+ * @tparam ValueType [in]: Value type of the leaf
+ */
+template <typename KeyType, typename ValueType>
+class GappedArray {
+public:
+
+    /**
+     * @brief Create an empty gapped array
+     * @param params [in]: Density and error thresholds
+     */
+    explicit GappedArray(const GappedLeafParameters &params = GappedLeafParameters()):
+        m_params(params), m_slope(0), m_intercept(0), m_numKeys(0), m_numInserts(0), m_numMispredictedInserts(0) {}
+
+    /**
+     * @brief Replace the contents of the array with sorted data
+     * @param data [in]: (key, value) pairs sorted by key
+     */
+    void bulkLoad(const std::vector<std::pair<KeyType, ValueType>> &data);
+
+    /**
+     * @brief Insert a key, shifting neighbours to the closest gap
+     * @param key [in]: The key to insert
+     * @param value [in]: The value to insert
+     */
+    void insert(KeyType key, ValueType value);
+
+    /**
+     * @brief Find a key in the array
+     * @param key [in]: The key to search for
+     * @return The (key, value) pair if found
+     */
+    boost::optional<std::pair<KeyType, ValueType>> find(KeyType key) const;
+
+    /**
+     * @brief Append every stored (key, value) pair, in sorted order
+     * @param output [out]: Where to append the pairs
+     */
+    template <typename DataAllocator>
+    void collect(std::vector<std::pair<KeyType, ValueType>, DataAllocator> &output) const;
+
+    /**
+     * @return The number of keys stored
+     */
+    size_t size() const {
+        return m_numKeys;
+    }
+
+    /**
+     * @return The number of slots (keys and gaps)
+     */
+    size_t capacity() const {
+        return m_keys.size();
+    }
+
+private:
+
+    /**
+     * @brief Predict the slot of a key with the leaf's linear model
+     */
+    size_t predictSlot(KeyType key) const {
+        double slot = m_slope * static_cast<double>(key) + m_intercept;
+        slot = std::max(0.0, std::min(slot, static_cast<double>(m_keys.size() - 1)));
+        return static_cast<size_t>(slot);
+    }
+
+    /**
+     * @brief Find the first slot whose key is >= key, searching outward from the predicted slot
+     * @return The slot, or capacity() if every key is smaller
+     */
+    size_t lowerBound(KeyType key) const;
+
+    /**
+     * @brief Rebuild the array at initialDensity, refitting the model
+     */
+    void rebuild();
+
+    GappedLeafParameters m_params;          ///< Density and error thresholds
+    double m_slope;                         ///< Slope of the key -> slot model
+    double m_intercept;                     ///< Intercept of the key -> slot model
+    std::vector<KeyType> m_keys;            ///< Keys, gaps copy the next key to their right
+    std::vector<ValueType> m_values;        ///< Values, meaningless in gaps
+    std::vector<bool> m_occupied;           ///< Whether each slot holds a real key
+    size_t m_numKeys;                       ///< Number of occupied slots
+    size_t m_numInserts;                    ///< Inserts since the last rebuild
+    size_t m_numMispredictedInserts;        ///< Inserts since the last rebuild that missed their predicted slot
+};
+
+template <typename KeyType, typename ValueType>
+void GappedArray<KeyType, ValueType>::bulkLoad(const std::vector<std::pair<KeyType, ValueType>> &data) {
+    m_numKeys = data.size();
+    m_numInserts = 0;
+    m_numMispredictedInserts = 0;
+
+    size_t capacity = static_cast<size_t>(data.size() / m_params.initialDensity) + 1;
+    m_keys.assign(capacity, std::numeric_limits<KeyType>::max());
+    m_values.assign(capacity, ValueType());
+    m_occupied.assign(capacity, false);
+
+    // Least squares fit of rank on key, scaled to the capacity
+    double meanKey = 0, meanRank = 0;
+    for (size_t ii = 0; ii < data.size(); ++ii) {
+        meanKey += static_cast<double>(data[ii].first);
+        meanRank += ii;
+    }
+    meanKey /= std::max(data.size(), static_cast<size_t>(1));
+    meanRank /= std::max(data.size(), static_cast<size_t>(1));
+
+    double covariance = 0, variance = 0;
+    for (size_t ii = 0; ii < data.size(); ++ii) {
+        double keyDelta = static_cast<double>(data[ii].first) - meanKey;
+        covariance += keyDelta * (ii - meanRank);
+        variance += keyDelta * keyDelta;
+    }
+    double rankSlope = variance > 0 ? covariance / variance : 0;
+    double scale = static_cast<double>(capacity) / std::max(data.size(), static_cast<size_t>(1));
+    m_slope = rankSlope * scale;
+    m_intercept = (meanRank - rankSlope * meanKey) * scale;
+
+    // Place each key at its predicted slot, keeping order and leaving room for the keys after it
+    long lastSlot = -1;
+    for (size_t ii = 0; ii < data.size(); ++ii) {
+        long slot = std::max(static_cast<long>(predictSlot(data[ii].first)), lastSlot + 1);
+        slot = std::min(slot, static_cast<long>(capacity - (data.size() - ii)));
+        m_keys[slot] = data[ii].first;
+        m_values[slot] = data[ii].second;
+        m_occupied[slot] = true;
+        lastSlot = slot;
+    }
+
+    // Fill gaps with the next key to their right
+    for (long slot = static_cast<long>(capacity) - 2; slot >= 0; --slot) {
+        if (!m_occupied[slot]) {
+            m_keys[slot] = m_keys[slot + 1];
+        }
+    }
+}
+
+template <typename KeyType, typename ValueType>
+size_t GappedArray<KeyType, ValueType>::lowerBound(KeyType key) const {
+    if (m_keys.empty()) {
+        return 0;
+    }
+
+    // Exponential search from the prediction to bracket the answer, then binary search inside the bracket
+    size_t predicted = predictSlot(key);
+    size_t low, high;
+    if (m_keys[predicted] < key) {
+        size_t step = 1;
+        low = predicted + 1;
+        high = predicted + step;
+        while (high < m_keys.size() && m_keys[high] < key) {
+            low = high + 1;
+            step *= 2;
+            high = predicted + step;
+        }
+        high = std::min(high, m_keys.size());
+    } else {
+        size_t step = 1;
+        high = predicted;
+        while (high >= step && !(m_keys[high - step] < key)) {
+            high -= step;
+            step *= 2;
+        }
+        low = high >= step ? high - step : 0;
+    }
+    return std::lower_bound(m_keys.begin() + low, m_keys.begin() + high, key) - m_keys.begin();
+}
+
+template <typename KeyType, typename ValueType>
+boost::optional<std::pair<KeyType, ValueType>> GappedArray<KeyType, ValueType>::find(KeyType key) const {
+    // Gaps copy the key to their right, so skip forward to the real one
+    for (size_t slot = lowerBound(key); slot < m_keys.size() && m_keys[slot] == key; ++slot) {
+        if (m_occupied[slot]) {
+            return std::pair<KeyType, ValueType>(key, m_values[slot]);
+        }
+    }
+    return {};
+}
+
+template <typename KeyType, typename ValueType>
+void GappedArray<KeyType, ValueType>::insert(KeyType key, ValueType value) {
+    if (m_keys.empty() || static_cast<float>(m_numKeys + 1) > m_params.maxDensity * m_keys.size()) {
+        m_numKeys++;
+        std::vector<std::pair<KeyType, ValueType>> data;
+        data.reserve(m_numKeys);
+        collect(data);
+        data.insert(std::upper_bound(data.begin(), data.end(), std::make_pair(key, value),
+                                     [](const std::pair<KeyType, ValueType> &p1, const std::pair<KeyType, ValueType> &p2) {
+                                         return p1.first < p2.first;
+                                     }), std::make_pair(key, value));
+        bulkLoad(data);
+        return;
+    }
+
+    size_t slot = lowerBound(key);
+
+    if (slot < m_keys.size() && !m_occupied[slot]) {
+        // Landed on a gap, nothing to move
+    } else {
+        // Find the closest gap on either side
+        size_t right = slot;
+        while (right < m_keys.size() && m_occupied[right]) {
+            ++right;
+        }
+        long left = static_cast<long>(slot) - 1;
+        while (left >= 0 && m_occupied[left]) {
+            --left;
+        }
+
+        if (right < m_keys.size() && (left < 0 || right - slot <= slot - left)) {
+            // Shift [slot, right) one to the right
+            std::move_backward(m_keys.begin() + slot, m_keys.begin() + right, m_keys.begin() + right + 1);
+            std::move_backward(m_values.begin() + slot, m_values.begin() + right, m_values.begin() + right + 1);
+            m_occupied[right] = true;
+        } else {
+            // Shift (left, slot) one to the left, and insert just before slot
+            std::move(m_keys.begin() + left + 1, m_keys.begin() + slot, m_keys.begin() + left);
+            std::move(m_values.begin() + left + 1, m_values.begin() + slot, m_values.begin() + left);
+            m_occupied[left] = true;
+            --slot;
+        }
+    }
+
+    m_keys[slot] = key;
+    m_values[slot] = value;
+    m_occupied[slot] = true;
+    m_numKeys++;
+
+    // Gaps directly to the left copied the key that used to be here
+    for (long gap = static_cast<long>(slot) - 1; gap >= 0 && !m_occupied[gap] && m_keys[gap] > key; --gap) {
+        m_keys[gap] = key;
+    }
+
+    m_numInserts++;
+    long predictionError = static_cast<long>(slot) - static_cast<long>(predictSlot(key));
+    if (std::abs(predictionError) > m_params.maxPredictionError) {
+        m_numMispredictedInserts++;
+        // Once a good fraction of recent inserts were placed far from the model, the model has drifted. Refit it.
+        // Waiting for a minimum number of inserts keeps a rebuild (linear in the leaf size) from following every miss
+        if (m_numInserts >= m_params.minRefitInserts && m_numMispredictedInserts * 4 > m_numInserts) {
+            rebuild();
+        }
+    }
+}
+
+template <typename KeyType, typename ValueType>
+template <typename DataAllocator>
+void GappedArray<KeyType, ValueType>::collect(std::vector<std::pair<KeyType, ValueType>, DataAllocator> &output) const {
+    for (size_t slot = 0; slot < m_keys.size(); ++slot) {
+        if (m_occupied[slot]) {
+            output.push_back({m_keys[slot], m_values[slot]});
+        }
+    }
+}
+
+template <typename KeyType, typename ValueType>
+void GappedArray<KeyType, ValueType>::rebuild() {
+    std::vector<std::pair<KeyType, ValueType>> data;
+    data.reserve(m_numKeys);
+    collect(data);
+    bulkLoad(data);
+}
+
+#endif //LEARNED_INDICES_GAPPEDARRAY_H
@@ -0,0 +1,228 @@
+/**
+ * @file NumaReplicatedIndex.h
+ *
+ * @brief A static index deployed across NUMA nodes, with the models replicated on every node
+ *
+ * @date 10/19/2026
+ */
+
+#ifndef LEARNED_INDICES_NUMAREPLICATEDINDEX_H
+#define LEARNED_INDICES_NUMAREPLICATEDINDEX_H
+
+#include "StaticRecursiveModelIndex.h"
+#include "utils/Numa.h"
+#include <new>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
+#include <boost/optional.hpp>
+
+/**
+ * @brief Serves lookups on a built StaticRecursiveModelIndex from every NUMA node without remote model accesses
+ *
+ * Every lookup reads the first stage weights and a node of the second stage, so each NUMA node gets its own copy
+ * of them (a few KB to a few MB), placed in its own memory. The sorted keys and values are much larger, so
+ * NumaParameters::dataPlacement picks between a full copy per node, one copy interleaved over the nodes, or
+ * one copy partitioned into a contiguous key range per node.
+ *
+ * Lookups name the node they run on. Workers pinned with runWorkers get theirs passed in. With partitioned
+ * data, ownerNode says which node's memory holds a key, so keys can be handed to workers on that node.
+ *
+ * The index is read only, like the StaticRecursiveModelIndex it copies.
+ *
+ * @tparam KeyType [in]: Key type of the index
+ * @tparam ValueType [in]: Value type of the index
+ * @tparam numNeurons [in]: Hidden width of the first stage
+ * @tparam secondStageSize [in]: Number of second stage nodes
+ * @tparam ModelType [in]: Second stage model
+ * @tparam SearchStrategy [in]: Last mile search
+ */
+template <typename KeyType, typename ValueType, size_t numNeurons, size_t secondStageSize,
+          typename ModelType = LinearRegressionModel, typename SearchStrategy = BinarySearch>
+class NumaReplicatedIndex {
+    static_assert(std::is_trivially_copyable<KeyType>::value && std::is_trivially_copyable<ValueType>::value,
+                  "Keys and values are copied into node memory as raw bytes");
+
+public:
+    typedef StaticRecursiveModelIndex<KeyType, ValueType, numNeurons, secondStageSize, ModelType, SearchStrategy> IndexType;
+
+    /**
+     * @brief Create an empty index
+     * @param params [in]: How many nodes to use and where the data lives
+     */
+    explicit NumaReplicatedIndex(const NumaParameters &params);
+
+    ~NumaReplicatedIndex() {
+        clear();
+    }
+
+    NumaReplicatedIndex(const NumaReplicatedIndex &) = delete;
+    NumaReplicatedIndex &operator=(const NumaReplicatedIndex &) = delete;
+
+    /**
+     * @brief Place copies of a built index's models and data on the nodes
+     * @param index [in]: The index to deploy. It is not referenced afterwards
+     */
+    void build(const IndexType &index);
+
+    /**
+     * @brief Find a specific item, using the models (and with replicated data, the data) of one node
+     * @param key [in]: A key to search for
+     * @param node [in]: The node the calling thread runs on
+     * @return A pair of (key, value) if found.
+     */
+    boost::optional<std::pair<KeyType, ValueType>> find(KeyType key, size_t node) const {
+        size_t begin, end, predicted;
+        m_models[node]->getSearchWindow(key, begin, end, predicted);
+        if (begin >= end) {
+            return {};
+        }
+
+        const size_t copy = m_params.dataPlacement == NumaDataPlacement::Replicate ? node : 0;
+        const KeyType *keys = static_cast<const KeyType *>(m_keyBuffers[copy].data());
+        size_t idx = SearchStrategy::lowerBound(keys, begin, end, predicted, key);
+        if (idx < end && keys[idx] == key) {
+            return std::make_pair(key, static_cast<const ValueType *>(m_valueBuffers[copy].data())[idx]);
+        }
+        return {};
+    }
+
+    /**
+     * @brief Which node's key range a key falls in. With partitioned data that node's memory holds it
+     * @param key [in]: A key
+     * @return The node
+     */
+    size_t ownerNode(KeyType key) const {
+        return std::upper_bound(m_partitionFirstKeys.begin(), m_partitionFirstKeys.end(), key) - m_partitionFirstKeys.begin();
+    }
+
+    /**
+     * @brief Run threadsPerNode lookup workers pinned to each node, and wait for all of them
+     * @param threadsPerNode [in]: Threads per node
+     * @param worker [in]: Called as worker(node, threadIndex) on each thread, to pass node to find
+     */
+    template <typename Worker>
+    void runWorkers(size_t threadsPerNode, Worker worker) const {
+        runPinnedWorkers(m_topology, threadsPerNode, worker);
+    }
+
+    /**
+     * @return The nodes the index is placed on
+     */
+    const NumaTopology &topology() const {
+        return m_topology;
+    }
+
+    /**
+     * @return The number of keys stored
+     */
+    size_t size() const {
+        return m_size;
+    }
+
+private:
+
+    /**
+     * @brief Destroy the model copies and free every buffer
+     */
+    void clear();
+
+    /**
+     * @brief Copy the keys and values into a new pair of buffers, after placing them with place(buffer, bytesPerKey)
+     */
+    template <typename Placement>
+    void copyData(const IndexType &index, Placement place);
+
+    NumaParameters m_params;                        ///< How many nodes to use and where the data lives
+    NumaTopology m_topology;                        ///< The nodes
+    std::vector<NumaBuffer> m_modelBuffers;         ///< Memory of each node's model copy, on that node
+    std::vector<IndexType *> m_models;              ///< Each node's model copy, without data
+    std::vector<NumaBuffer> m_keyBuffers;           ///< Sorted keys, one buffer per node if replicated
+    std::vector<NumaBuffer> m_valueBuffers;         ///< Values matching the keys
+    std::vector<KeyType> m_partitionFirstKeys;      ///< First key of each node's range, but the first node's
+    size_t m_size;                                  ///< Number of keys stored
+};
+
+template <typename KeyType, typename ValueType, size_t numNeurons, size_t secondStageSize, typename ModelType, typename SearchStrategy>
+NumaReplicatedIndex<KeyType, ValueType, numNeurons, secondStageSize, ModelType, SearchStrategy>::NumaReplicatedIndex(
+        const NumaParameters &params):
+    m_params(params), m_topology(NumaTopology::withNodes(params.numNodes)), m_size(0)
+{
+    if (m_topology.isEmulated()) {
+        std::cerr << "Emulating " << m_topology.numNodes() << " NUMA nodes" << std::endl;
+    }
+}
+
+template <typename KeyType, typename ValueType, size_t numNeurons, size_t secondStageSize, typename ModelType, typename SearchStrategy>
+void NumaReplicatedIndex<KeyType, ValueType, numNeurons, secondStageSize, ModelType, SearchStrategy>::build(const IndexType &index) {
+    clear();
+    const size_t numNodes = m_topology.numNodes();
+    m_size = index.size();
+
+    // Copy only the models into memory bound to each node, the data is placed below
+    for (size_t node = 0; node < numNodes; ++node) {
+        m_modelBuffers.emplace_back(sizeof(IndexType));
+        m_modelBuffers.back().bindToNode(m_topology, node);
+        m_models.push_back(new (m_modelBuffers.back().data()) IndexType());
+        m_models.back()->copyModels(index);
+    }
+
+    switch (m_params.dataPlacement) {
+        case NumaDataPlacement::Replicate:
+            for (size_t node = 0; node < numNodes; ++node) {
+                copyData(index, [&](NumaBuffer &buffer, size_t) {
+                    buffer.bindToNode(m_topology, node);
+                });
+            }
+            break;
+        case NumaDataPlacement::Interleave:
+            copyData(index, [&](NumaBuffer &buffer, size_t) {
+                buffer.interleave(m_topology);
+            });
+            break;
+        case NumaDataPlacement::Partition:
+            // Contiguous position ranges, so one buffer still serves every search window
+            copyData(index, [&](NumaBuffer &buffer, size_t bytesPerKey) {
+                for (size_t node = 0; node < numNodes; ++node) {
+                    size_t first = node * m_size / numNodes;
+                    size_t last = (node + 1) * m_size / numNodes;
+                    buffer.bindToNode(m_topology, node, first * bytesPerKey, (last - first) * bytesPerKey);
+                }
+            });
+            break;
+    }
+
+    for (size_t node = 1; node < numNodes && m_size > 0; ++node) {
+        m_partitionFirstKeys.push_back(index.keys()[std::min(node * m_size / numNodes, m_size - 1)]);
+    }
+}
+
+template <typename KeyType, typename ValueType, size_t numNeurons, size_t secondStageSize, typename ModelType, typename SearchStrategy>
+template <typename Placement>
+void NumaReplicatedIndex<KeyType, ValueType, numNeurons, secondStageSize, ModelType, SearchStrategy>::copyData(
+        const IndexType &index, Placement place) {
+    // Placed before the copy touches any page, so pages are allocated where the policy says
+    m_keyBuffers.emplace_back(m_size * sizeof(KeyType));
+    place(m_keyBuffers.back(), sizeof(KeyType));
+    std::memcpy(m_keyBuffers.back().data(), index.keys().data(), m_size * sizeof(KeyType));
+
+    m_valueBuffers.emplace_back(m_size * sizeof(ValueType));
+    place(m_valueBuffers.back(), sizeof(ValueType));
+    std::memcpy(m_valueBuffers.back().data(), index.values().data(), m_size * sizeof(ValueType));
+}
+
+template <typename KeyType, typename ValueType, size_t numNeurons, size_t secondStageSize, typename ModelType, typename SearchStrategy>
+void NumaReplicatedIndex<KeyType, ValueType, numNeurons, secondStageSize, ModelType, SearchStrategy>::clear() {
+    for (auto model : m_models) {
+        model->~IndexType();
+    }
+    m_models.clear();
+    m_modelBuffers.clear();
+    m_keyBuffers.clear();
+    m_valueBuffers.clear();
+    m_partitionFirstKeys.clear();
+    m_size = 0;
+}
+
+#endif //LEARNED_INDICES_NUMAREPLICATEDINDEX_H
@@ -11,8 +11,16 @@
 #define LEARNED_INDICES_RECURSIVEMODELINDEX_H
 
 #include "SecondStageNode.h"
+#include "FirstStageTrainer.h"
+#include "CompressedKeyArray.h"
+#include "utils/Arena.h"
+#include "utils/BloomFilter.h"
 #include "utils/DataUtils.h"
+#include "utils/ModelWeights.h"
 #include "utils/NetworkParameters.h"
+#include "utils/QuantizedModel.h"
+#include "utils/Snapshot.h"
+#include "utils/WriteAheadLog.h"
 #include "../external/nn_cpp/nn/Net.h"
 #include "../external/cpp-btree/btree_map.h"
 #include <boost/optional.hpp>
@@ -23,8 +31,10 @@
  * @tparam KeyType: The key type of our index
  * @tparam ValueType: The value we are storing
  * @tparam secondStageSize: The size of our second stage of our index
+ * @tparam Allocator: Allocator of the sorted data, overflow array and node array (e.g. HugePageAllocator)
  */
-template <typename KeyType, typename ValueType, int secondStageSize>
+template <typename KeyType, typename ValueType, int secondStageSize,
+          typename Allocator = std::allocator<std::pair<KeyType, ValueType>>>
 class RecursiveModelIndex {
 public:
 
@@ -55,13 +65,282 @@ public:
      */
     boost::optional<std::pair<KeyType, ValueType>> find(KeyType key);
 
+    /**
+     * @brief Find many keys at once, interleaving the lookups so their cache misses overlap.
+     * Each lookup prefetches the next part of m_data it needs and yields to the other lookups in flight,
+     * so on data much larger than the cache many misses are outstanding at once instead of one.
+     * Only window searches are interleaved. A node that uses its B-tree is walked to the end when its lookup
+     * starts, and just the entry it found is prefetched, so indexes whose nodes mostly fall back to trees gain little
+     * @param keys [in]: The keys to search for
+     * @param results [out]: The (key, value) pair for each key, if found
+     * @param numInFlight [in]: How many lookups to interleave
+     */
+    void findBatch(const std::vector<KeyType> &keys,
+                   std::vector<boost::optional<std::pair<KeyType, ValueType>>> &results,
+                   size_t numInFlight = 16);
+
     /**
      * @brief Train our index structure
      */
     void train();
 
+    /**
+     * @brief Check keys against an existence filter before searching, so lookups for missing keys
+     * return without touching the overflow array or the models. Takes effect on the next train()
+     * @param params [in]: The false positive rate and memory budget of the filter
+     */
+    void enableExistenceFilter(const ExistenceFilterParameters &params);
+
+    /**
+     * @brief Fit both stages on an evenly spaced sample of the sorted keys instead of all of them.
+     * Error bounds stay exact: they are computed in one streaming pass over all the data. Takes effect on the next train()
+     * @param params [in]: How large a sample to fit on
+     */
+    void enableSampledBuild(const SampledBuildParameters &params);
+
+    /**
+     * @brief Move the data into gapped array leaves owned by the second stage nodes. Inserts then land in
+     * place in their leaf instead of the overflow array, and never force a retrain. Takes effect on the next train()
+     * @param params [in]: Density and size thresholds of the leaves
+     */
+    void enableGappedLeaves(const GappedLeafParameters &params);
+
+    /**
+     * @brief Use pre-trained models from a weight file (see utils/ModelWeights.h) instead of training our own.
+     * train() then skips model fitting and only recomputes error bounds against the current data. The models take
+     * effect on the next train(), until then lookups keep using the current ones
+     * @param path [in]: The weight file, e.g. exported from notebooks/learned_index_pytorch.ipynb
+     * @return Whether the models were loaded. On failure the index is unchanged
+     */
+    bool loadModels(const std::string &path);
+
+    /**
+     * @brief Write the trained models to a weight file that loadModels (or the notebook) can read.
+     * nn_cpp does not expose the first stage network's parameters, so the first stage has to be loaded or
+     * trained with FirstStageTrainer (enableParallelTraining or enableQuantizedInference)
+     * @param path [in]: The weight file
+     * @return Whether the models were written
+     */
+    bool saveModels(const std::string &path);
+
+    /**
+     * @brief Train the first stage with FirstStageTrainer on several threads, stopping once the loss plateaus,
+     * instead of on one thread for exactly maxNumEpochs batches. Takes effect on the next train()
+     * @param params [in]: Number of threads, synchronous or Hogwild updates, and the convergence criteria
+     */
+    void enableParallelTraining(const ParallelTrainingParameters &params);
+
+    /**
+     * @brief Route and position keys with fixed point copies of the models (see utils/QuantizedModel.h), so
+     * lookups do no float arithmetic. Error bounds are computed against the quantized models, so lookups stay
+     * exact. nn_cpp does not expose the first stage network's parameters, so unless models are loaded the first
+     * stage is trained with FirstStageTrainer. That runs on one thread unless enableParallelTraining asks for more.
+     * Only integer keys can be quantized. Takes effect on the next train()
+     */
+    void enableQuantizedInference();
+
+    /**
+     * @brief Store the sorted keys frame of reference compressed (see CompressedKeyArray.h), with the values
+     * in a separate array. Cuts key memory 2-4x for 64 bit keys. Has no effect while gapped leaves own the
+     * data. Only integer keys can be compressed. Takes effect on the next train()
+     */
+    void enableCompressedKeys();
+
+    /**
+     * @brief Log every insert to a write ahead log, and have train() persist the sorted data to a snapshot and
+     * truncate the log. Inserts that don't retrain (e.g. into gapped leaves) snapshot everything stored once the
+     * log reaches maxLogRecords, so it never grows without bound. Recovers first: loads the snapshot, if any, and
+     * replays the rest of the log into the overflow array. Call this on a new index, then train() to index the
+     * recovered data
+     * @param params [in]: The log and snapshot files, how many inserts share one fsync, and the log size limit
+     * @return Whether recovery succeeded and the log is open. On failure the index is unchanged
+     */
+    bool enableWriteAheadLog(const WriteAheadLogParameters &params);
+
+    /**
+     * @brief Make every logged insert durable now, instead of when its group commits
+     * @return Whether the inserts are durable
+     */
+    bool syncWriteAheadLog();
+
 private:
 
+    typedef std::vector<std::pair<KeyType, ValueType>, Allocator> DataVector;
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<SecondStageNode<KeyType, ValueType>> NodeAllocator;
+    typedef std::vector<ValueType, typename std::allocator_traits<Allocator>::template rebind_alloc<ValueType>> ValueVector;
+
+    /// A transient buffer used while training, freed in one shot at the end of train()
+    template <typename T>
+    using TrainingVector = std::vector<T, ArenaAllocator<T>>;
+
+    /**
+     * @brief Create one empty training buffer per second stage node, drawing from the training arena with exactly
+     * the capacity it will need. The arena never frees, so a buffer grown by doubling would leave every smaller
+     * copy of itself behind
+     * @param counts [in]: How many entries each node's buffer will get
+     */
+    template <typename T>
+    std::vector<TrainingVector<T>> makePerStageBuffers(const TrainingVector<size_t> &counts) {
+        std::vector<TrainingVector<T>> buffers(secondStageSize, TrainingVector<T>(ArenaAllocator<T>(&m_trainingArena)));
+        for (int stage = 0; stage < secondStageSize; ++stage) {
+            buffers[stage].reserve(counts[stage]);
+        }
+        return buffers;
+    }
+
+    /**
+     * @brief Route every stride-th key of m_data to its second stage node
+     * @param stride [in]: Distance between the routed keys
+     * @param stages [out]: The node of each routed key, in order
+     * @param counts [out]: How many routed keys each node got
+     */
+    void routeData(size_t stride, TrainingVector<int> &stages, TrainingVector<size_t> &counts);
+
+    /**
+     * @brief What a findBatch lookup over compressed keys waits on next
+     */
+    enum class CompressedStep {
+        SearchBlocks,   ///< The entry of the block in the middle of the window
+        ScanBlock,      ///< The packed offsets of the one block left
+        ReadValue       ///< The value of the found key, stored apart from the keys
+    };
+
+    /**
+     * @brief The state of one suspended lookup in findBatch
+     */
+    struct LookupState {
+        size_t keyIdx;      ///< Index of the key (and result) in the batch
+        KeyType key;        ///< The key we are searching for
+        size_t low;         ///< Everything in m_data before low is smaller than key
+        size_t high;        ///< Everything in the window from high on is >= key
+        size_t windowEnd;   ///< End of the search window in m_data
+        CompressedStep step;///< Compressed keys only: what the lookup waits on
+    };
+
+    /**
+     * @brief Start a lookup, resolving it right away if it doesn't touch m_data
+     * @return Whether the lookup is waiting on a prefetch of m_data and needs resumeLookup
+     */
+    bool beginLookup(LookupState &state, boost::optional<std::pair<KeyType, ValueType>> &result);
+
+    /**
+     * @brief Take one binary search step of a lookup on the (prefetched) data, and prefetch the next
+     * @return Whether the lookup still needs more steps
+     */
+    bool resumeLookup(LookupState &state, boost::optional<std::pair<KeyType, ValueType>> &result);
+
+    /**
+     * @brief Compressed keys are searched by block first, comparing block base keys only
+     * @return The block in the middle of the lookup's window, or the one block left
+     */
+    size_t getCompressedProbe(const LookupState &state) const;
+
+    /**
+     * @brief Prefetch the packed offsets of the window's one block left, which can be a few cache lines
+     */
+    void prefetchCompressedBlock(const LookupState &state) const;
+
+    /**
+     * @brief Compute the range of m_data a second stage node guarantees the key is in, if stored
+     * @param stage [in]: The node the key routes to
+     * @param key [in]: The key we are searching for
+     * @param startIdx [out]: Start of the window
+     * @param endIdx [out]: One past the end of the window
+     */
+    void getSearchWindow(int stage, KeyType key, size_t &startIdx, size_t &endIdx);
+
+    /**
+     * @return The number of sorted keys, whether stored raw in m_data or compressed
+     */
+    size_t getDataSize() const {
+        return m_keysCompressed ? m_compressedKeys.size() : m_data.size();
+    }
+
+    /**
+     * @return The key at a position in the sorted data
+     */
+    KeyType getKey(size_t idx) const {
+        return m_keysCompressed ? m_compressedKeys.get(idx) : m_data[idx].first;
+    }
+
+    /**
+     * @return The (key, value) pair at a position in the sorted data
+     */
+    std::pair<KeyType, ValueType> getEntry(size_t idx) const {
+        return m_keysCompressed ? std::make_pair(m_compressedKeys.get(idx), m_values[idx]) : m_data[idx];
+    }
+
+    /**
+     * @brief Prefetch the key at a position in the sorted data
+     */
+    void prefetchKey(size_t idx) const {
+        if (m_keysCompressed) {
+            __builtin_prefetch(m_compressedKeys.getAddress(idx));
+        } else {
+            __builtin_prefetch(&m_data[idx]);
+        }
+    }
+
+    /**
+     * @brief Durably snapshot every stored pair, then truncate the write ahead log it now covers
+     */
+    void persistSnapshot();
+
+    /**
+     * @brief Move m_data into the compressed keys and value array, and release m_data
+     */
+    void compressData();
+
+    /**
+     * @brief Decode the compressed keys back into m_data, and release the compressed storage
+     */
+    void decompressData();
+
+    /**
+     * @brief Evaluate the first stage (network, or imported or parallel trained parameters)
+     * @param key [in]: The key to evaluate
+     * @return The predicted position divided by the dataset size
+     */
+    float evaluateFirstStage(KeyType key);
+
+    /**
+     * @brief Replace the first stage with its quantized copy, covering the keys in m_data
+     */
+    void quantizeFirstStage();
+
+    /**
+     * @brief Replace every second stage model with its quantized copy, and recompute the error bounds
+     */
+    void quantizeSecondStage();
+
+    /**
+     * @brief Compute exact error bounds for every node in one pass over m_data, building trees where needed
+     */
+    void computeSecondStageErrorBounds();
+
+    /**
+     * @brief Route all of m_data into the second stage nodes' leaves, and release m_data
+     */
+    void buildGappedLeaves();
+
+    /**
+     * @brief Append every stored pair, wherever it lives (m_data, compressed keys, leaves, overflow array)
+     * @param output [out]: Where to append the pairs, not in any particular order
+     */
+    void collectData(DataVector &output) const;
+
+    /**
+     * @brief Route a key to a second stage node with the first stage
+     * @param key [in]: The key to route
+     * @return The index of the second stage node
+     */
+    int getStage(KeyType key);
+
+    /**
+     * @return The stride between sampled keys in m_data (1 when we fit on everything)
+     */
+    size_t getSampleStride() const;
+
     /**
      * @brief Train the first stage of the network
      */
@@ -72,28 +351,76 @@ private:
      */
     void trainSecondStage();
 
+    /**
+     * @brief Fit the second stage on a sample, then compute exact error bounds in one pass over m_data
+     */
+    void trainSecondStageSampled();
+
     ///------------ Data members ----------------
-    std::vector<std::pair<KeyType, ValueType>> m_data;                 ///< The data our learned index tries to find
+    DataVector m_data;                                                 ///< The data our learned index tries to find
 
     NetworkParameters m_firstStageParams;                              ///< First stage network parameters
     NetworkParameters m_secondStageParams;                             ///< Our second stage network parameters
     std::unique_ptr<nn::Net<float>> m_firstStageNetwork;               ///< The first stage neural network
-    std::vector<SecondStageNode<KeyType>> m_secondStage;                   ///< The second stage (network or btree)
+    std::vector<SecondStageNode<KeyType, ValueType>, NodeAllocator> m_secondStage;  ///< The second stage (network or btree)
     int m_maxSecondStageError;                                         ///< Max second stage error before replacing with btree
 
     int m_currentOverflowSize;                                         ///< Number of inserts stored in overflow array
     int m_maxOverflowSize;                                             ///< Max size we let overflow array get before retraining
-    std::vector<std::pair<KeyType, ValueType>> m_overflowArray;        ///< The overflow array
+    DataVector m_overflowArray;                                        ///< The overflow array
+
+    bool m_useExistenceFilter;                                         ///< Whether to check the existence filter in find
+    ExistenceFilterParameters m_existenceFilterParams;                 ///< Existence filter false positive rate and budget
+    BloomFilter<KeyType> m_existenceFilter;                            ///< Filter over all keys in the data and overflow array
+    KeyType m_minKey;                                                  ///< Smallest key stored, valid once the filter is built
+    KeyType m_maxKey;                                                  ///< Largest key stored, valid once the filter is built
+
+    bool m_useSampledBuild;                                            ///< Whether to fit models on a sample of m_data
+    SampledBuildParameters m_sampledBuildParams;                       ///< Size of the sample to fit on
+    Eigen::Tensor<float, 2> m_routingInput;                            ///< Reused first stage input when routing keys
+
+    bool m_useGappedLeaves;                                            ///< Whether to move data into leaves after training
+    GappedLeafParameters m_gappedLeafParams;                           ///< Density and size thresholds of the leaves
+    bool m_leavesBuilt;                                                ///< Whether the leaves (not m_data) currently own the data
+
+    bool m_useImportedModels;                                          ///< Whether models were loaded instead of trained
+    bool m_hasPendingModels;                                           ///< Whether loadModels left models for the next train()
+    FirstStageWeights m_pendingFirstStage;                             ///< First stage parameters loaded for the next train()
+    std::vector<LinearModelWeights> m_pendingSecondStage;              ///< Second stage parameters loaded for the next train()
+    bool m_useExplicitFirstStage;                                      ///< Whether m_explicitFirstStage (not the network) routes keys
+    FirstStageWeights m_explicitFirstStage;                            ///< First stage parameters set by loadModels or parallel training
+
+    bool m_useParallelTraining;                                        ///< Whether to train the first stage with FirstStageTrainer
+    ParallelTrainingParameters m_parallelTrainingParams;               ///< Threads and convergence criteria of parallel training
+
+    bool m_useQuantizedInference;                                      ///< Whether to quantize the models after training
+    bool m_firstStageQuantized;                                        ///< Whether m_quantizedFirstStage routes keys
+    QuantizedPiecewiseLinearModelFor<KeyType> m_quantizedFirstStage;  ///< First stage in fixed point, predicts the node index
+
+    Arena m_trainingArena;                                             ///< Backs transient training buffers, released after train()
+
+    bool m_useCompressedKeys;                                          ///< Whether to compress the keys after training
+    bool m_keysCompressed;                                             ///< Whether the compressed keys (not m_data) currently own the data
+    CompressedKeyStorage<KeyType> m_compressedKeys;                    ///< Sorted keys, compressed (integer keys only)
+    ValueVector m_values;                                              ///< Values matching m_compressedKeys position for position
+
+    WriteAheadLog<KeyType, ValueType> m_writeAheadLog;                 ///< Log of inserts since the last snapshot, if enabled
+    std::string m_snapshotPath;                                        ///< Where train() persists the sorted data
+    size_t m_maxLogRecords;                                            ///< Log records at which an insert snapshots, 0 for never
 };
 
 
-template <typename KeyType, typename ValueType, int secondStageSize>
-RecursiveModelIndex<KeyType, ValueType, secondStageSize>::RecursiveModelIndex(const NetworkParameters &firstStageParams,
+template <typename KeyType, typename ValueType, int secondStageSize, typename Allocator>
+RecursiveModelIndex<KeyType, ValueType, secondStageSize, Allocator>::RecursiveModelIndex(const NetworkParameters &firstStageParams,
                                                                               const NetworkParameters &secondStageParams,
                                                                               int maxSecondStageError,
                                                                               int maxOverflowSize):
     m_firstStageParams(firstStageParams), m_secondStageParams(secondStageParams),
-    m_maxSecondStageError(maxSecondStageError), m_maxOverflowSize(maxOverflowSize)
+    m_maxSecondStageError(maxSecondStageError), m_currentOverflowSize(0), m_maxOverflowSize(maxOverflowSize),
+    m_useExistenceFilter(false), m_minKey(), m_maxKey(), m_useSampledBuild(false), m_routingInput(1, 1),
+    m_useGappedLeaves(false), m_leavesBuilt(false), m_useImportedModels(false), m_hasPendingModels(false),
+    m_useExplicitFirstStage(false), m_useParallelTraining(false), m_useQuantizedInference(false),
+    m_firstStageQuantized(false), m_useCompressedKeys(false), m_keysCompressed(false), m_maxLogRecords(0)
 {
 
     // Create our first network
@@ -104,23 +431,54 @@ RecursiveModelIndex<KeyType, ValueType, secondStageSize>::RecursiveModelIndex(co
 
     // Create all our second stage models
     for (size_t ii = 0; ii < secondStageSize; ++ii) {
-        m_secondStage.emplace_back(SecondStageNode<KeyType>(m_maxSecondStageError, secondStageParams.batchSize));
+        m_secondStage.emplace_back(SecondStageNode<KeyType, ValueType>(m_maxSecondStageError, secondStageParams.batchSize));
     }
 }
 
-template <typename KeyType, typename ValueType, int secondStageSize>
-void RecursiveModelIndex<KeyType, ValueType, secondStageSize>::insert(KeyType key, ValueType value) {
-    m_overflowArray.push_back({key, value});
-    m_currentOverflowSize ++;
+template <typename KeyType, typename ValueType, int secondStageSize, typename Allocator>
+void RecursiveModelIndex<KeyType, ValueType, secondStageSize, Allocator>::insert(KeyType key, ValueType value) {
+    if (m_writeAheadLog.isOpen() && !m_writeAheadLog.append(key, value)) {
+        std::cerr << "Failed to log insert of key: " << key << std::endl;
+    }
+
+    if (m_useExistenceFilter) {
+        m_existenceFilter.insert(key);
+        m_minKey = std::min(m_minKey, key);
+        m_maxKey = std::max(m_maxKey, key);
+    }
 
-    // TODO: This should really be a background task
-    if (m_currentOverflowSize > m_maxOverflowSize) {
-        train();
+    // Leaves take the insert in place, so there is nothing to buffer or retrain
+    if (m_leavesBuilt) {
+        m_secondStage[getStage(key)].leafInsert(key, value);
+    } else {
+        m_overflowArray.push_back({key, value});
+        m_currentOverflowSize ++;
+
+        // TODO: This should really be a background task
+        if (m_currentOverflowSize > m_maxOverflowSize) {
+            train();
+        }
+    }
+
+    // Retraining truncates the log, but nothing else does. Bound it by snapshotting whatever we hold now
+    if (m_writeAheadLog.isOpen() && m_maxLogRecords > 0 && m_writeAheadLog.numRecords() >= m_maxLogRecords) {
+        persistSnapshot();
     }
 };
 
-template <typename KeyType, typename ValueType, int secondStageSize>
-boost::optional<std::pair<KeyType, ValueType>> RecursiveModelIndex<KeyType, ValueType, secondStageSize>::find(KeyType key) {
+template <typename KeyType, typename ValueType, int secondStageSize, typename Allocator>
+boost::optional<std::pair<KeyType, ValueType>> RecursiveModelIndex<KeyType, ValueType, secondStageSize, Allocator>::find(KeyType key) {
+    // Reject keys we know aren't stored before doing any real work
+    if (m_useExistenceFilter && m_existenceFilter.numHashes() > 0) {
+        if (key < m_minKey || key > m_maxKey || !m_existenceFilter.mayContain(key)) {
+            return {};
+        }
+    }
+
+    if (m_leavesBuilt) {
+        return m_secondStage[getStage(key)].leafFind(key);
+    }
+
     // TODO: Order of searching?
     auto overflowResult = std::find_if(m_overflowArray.begin(), m_overflowArray.end(), [&](const std::pair<KeyType, ValueType> &pair) {
         return pair.first == key;
@@ -131,22 +489,9 @@ boost::optional<std::pair<KeyType, ValueType>> RecursiveModelIndex<KeyType, Valu
     }
 
     // Now search using the RecursiveModelIndex!
-    Eigen::Tensor<float, 2> input(1, 1);
-    input(0, 0) = static_cast<float>(key);
-
-    auto result = m_firstStageNetwork->forward<2, 2>(input);
-    auto resultIdx = result * result.constant(m_data.size());
-
-    // Calculate which stage we want to send this data to
-    // If we take the result (unscaled, so closer to 0-1), and multiply by the
-    // number of stages we get an assignment
-    int stage = static_cast<int>(result(0, 0) * secondStageSize);
+    int stage = getStage(key);
 
-    // Cap the range of stages to 0 -> (secondStageSize - 1)
-    stage = std::max(0, stage);
-    stage = std::min(secondStageSize - 1, stage);
-
-    std::cout << "Finding: " << key << " Predicted: " << resultIdx << " assigned to stage: " << stage << std::endl;
+    std::cout << "Finding: " << key << " assigned to stage: " << stage << std::endl;
 
     if (m_secondStage[stage].isValid()) {
         if (m_secondStage[stage].useTree()) {
@@ -154,16 +499,21 @@ boost::optional<std::pair<KeyType, ValueType>> RecursiveModelIndex<KeyType, Valu
             std::cout << "Using tree" << std::endl;
             auto treeResult = m_secondStage[stage].treeFind(key);
             if (treeResult) {
-                return {key, m_data[treeResult.get().second]};
+                return getEntry(treeResult.get().second);
             } else {
                 return {};
             }
         } else {
-            // TODO: Too much casting, long vs size_t vs int... Clean this mess up. Bugs have to be everywhere
-            long predictedIdx = m_secondStage[stage].predict(key, m_data.size());
-            // Search from min to max around predictedIdx
-            size_t startIdx = std::max(static_cast<long>(0), predictedIdx + m_secondStage[stage].getMaxNegativeError());
-            size_t endIdx = std::min(m_data.size() - 1, static_cast<size_t>(predictedIdx + m_secondStage[stage].getMaxPositiveError()));
+            size_t startIdx, endIdx;
+            getSearchWindow(stage, key, startIdx, endIdx);
+
+            if (m_keysCompressed) {
+                size_t idx = m_compressedKeys.lowerBound(startIdx, endIdx, key);
+                if (idx < endIdx && m_compressedKeys.get(idx) == key) {
+                    return std::make_pair(key, m_values[idx]);
+                }
+                return {};
+            }
 
             auto findResult = std::find_if(m_data.begin() + startIdx, m_data.begin() + endIdx,
                                            [&](const std::pair<KeyType, ValueType> &pair) {
@@ -183,9 +533,219 @@ boost::optional<std::pair<KeyType, ValueType>> RecursiveModelIndex<KeyType, Valu
     return {};
 };
 
-template <typename KeyType, typename ValueType, int secondStageSize>
-void RecursiveModelIndex<KeyType, ValueType, secondStageSize>::train() {
+template <typename KeyType, typename ValueType, int secondStageSize, typename Allocator>
+void RecursiveModelIndex<KeyType, ValueType, secondStageSize, Allocator>::findBatch(const std::vector<KeyType> &keys,
+                                                                         std::vector<boost::optional<std::pair<KeyType, ValueType>>> &results,
+                                                                         size_t numInFlight) {
+    results.assign(keys.size(), boost::none);
+
+    // Leaves have their own layout, so there is no m_data to interleave accesses to
+    if (m_leavesBuilt) {
+        for (size_t ii = 0; ii < keys.size(); ++ii) {
+            results[ii] = find(keys[ii]);
+        }
+        return;
+    }
+
+    std::vector<LookupState> inFlight(std::min(std::max(numInFlight, static_cast<size_t>(1)), keys.size()));
+    std::vector<bool> active(inFlight.size(), false);
+    size_t nextKey = 0;
+
+    // Fill a slot with the next lookup that has to wait on memory, resolving the rest on the way
+    auto startNext = [&](LookupState &state) {
+        while (nextKey < keys.size()) {
+            state.keyIdx = nextKey++;
+            state.key = keys[state.keyIdx];
+            if (beginLookup(state, results[state.keyIdx])) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    size_t numActive = 0;
+    for (size_t slot = 0; slot < inFlight.size(); ++slot) {
+        active[slot] = startNext(inFlight[slot]);
+        numActive += active[slot];
+    }
+
+    // Round robin over the lookups in flight. By the time we come back to one its prefetch has landed
+    while (numActive > 0) {
+        for (size_t slot = 0; slot < inFlight.size(); ++slot) {
+            if (!active[slot] || resumeLookup(inFlight[slot], results[inFlight[slot].keyIdx])) {
+                continue;
+            }
+            active[slot] = startNext(inFlight[slot]);
+            numActive -= !active[slot];
+        }
+    }
+}
+
+template <typename KeyType, typename ValueType, int secondStageSize, typename Allocator>
+bool RecursiveModelIndex<KeyType, ValueType, secondStageSize, Allocator>::beginLookup(LookupState &state,
+                                                                           boost::optional<std::pair<KeyType, ValueType>> &result) {
+    const KeyType key = state.key;
+    if (m_useExistenceFilter && m_existenceFilter.numHashes() > 0) {
+        if (key < m_minKey || key > m_maxKey || !m_existenceFilter.mayContain(key)) {
+            return false;
+        }
+    }
+
+    if (!m_overflowArray.empty()) {
+        auto overflowResult = std::find_if(m_overflowArray.begin(), m_overflowArray.end(), [&](const std::pair<KeyType, ValueType> &pair) {
+            return pair.first == key;
+        });
+        if (overflowResult != m_overflowArray.end()) {
+            result = *overflowResult;
+            return false;
+        }
+    }
+
+    int stage = getStage(key);
+    if (!m_secondStage[stage].isValid()) {
+        return false;
+    }
+
+    if (m_secondStage[stage].useTree()) {
+        auto treeResult = m_secondStage[stage].treeFind(key);
+        if (!treeResult) {
+            return false;
+        }
+        // The tree knows exactly where the key is, we only wait on that one entry
+        state.low = treeResult.get().second;
+        state.high = state.low;
+        state.windowEnd = state.low + 1;
+    } else {
+        getSearchWindow(stage, key, state.low, state.windowEnd);
+        state.high = state.windowEnd;
+        if (state.low >= state.windowEnd) {
+            return false;
+        }
+    }
+
+    if (m_keysCompressed) {
+        // The packed offsets can't be addressed before their block's entry arrives
+        state.step = CompressedStep::SearchBlocks;
+        __builtin_prefetch(m_compressedKeys.getBlockAddress(state.low / CompressedKeyStorage<KeyType>::BLOCK_SIZE));
+        __builtin_prefetch(m_compressedKeys.getBlockAddress(getCompressedProbe(state)));
+    } else {
+        prefetchKey(state.low + (state.high - state.low) / 2);
+    }
+    return true;
+}
+
+template <typename KeyType, typename ValueType, int secondStageSize, typename Allocator>
+size_t RecursiveModelIndex<KeyType, ValueType, secondStageSize, Allocator>::getCompressedProbe(const LookupState &state) const {
+    const size_t blockSize = CompressedKeyStorage<KeyType>::BLOCK_SIZE;
+    size_t lowBlock = state.low / blockSize;
+    size_t highBlock = (std::max(state.high, state.low + 1) - 1) / blockSize;
+    return lowBlock + (highBlock - lowBlock + 1) / 2;
+}
+
+template <typename KeyType, typename ValueType, int secondStageSize, typename Allocator>
+void RecursiveModelIndex<KeyType, ValueType, secondStageSize, Allocator>::prefetchCompressedBlock(const LookupState &state) const {
+    const size_t blockSize = CompressedKeyStorage<KeyType>::BLOCK_SIZE;
+    size_t end = std::min(state.windowEnd, (state.low / blockSize + 1) * blockSize);
+    const char *first = static_cast<const char *>(m_compressedKeys.getAddress(state.low));
+    const char *last = static_cast<const char *>(m_compressedKeys.getAddress(std::max(end, state.low + 1) - 1));
+    for (const char *address = first; address < last; address += 64) {
+        __builtin_prefetch(address);
+    }
+    __builtin_prefetch(last);
+}
+
+template <typename KeyType, typename ValueType, int secondStageSize, typename Allocator>
+bool RecursiveModelIndex<KeyType, ValueType, secondStageSize, Allocator>::resumeLookup(LookupState &state,
+                                                                            boost::optional<std::pair<KeyType, ValueType>> &result) {
+    if (m_keysCompressed) {
+        // Binary search the block base keys, without touching the packed offsets, until one block is left.
+        // Then only that block's offsets have to arrive, and they are compared a vector at a time
+        const size_t blockSize = CompressedKeyStorage<KeyType>::BLOCK_SIZE;
+        if (state.step == CompressedStep::SearchBlocks) {
+            size_t block = getCompressedProbe(state);
+            if (block != state.low / blockSize) {
+                if (m_compressedKeys.getBlockBase(block) < state.key) {
+                    state.low = block * blockSize;
+                } else {
+                    state.high = block * blockSize;
+                }
+                block = getCompressedProbe(state);
+                if (block != state.low / blockSize) {
+                    __builtin_prefetch(m_compressedKeys.getBlockAddress(block));
+                    return true;
+                }
+            }
+            prefetchCompressedBlock(state);
+            state.step = CompressedStep::ScanBlock;
+            return true;
+        }
+
+        if (state.step == CompressedStep::ReadValue) {
+            result = std::make_pair(state.key, m_values[state.low]);
+            return false;
+        }
+
+        // The key's lower bound is in the rest of this block or at the start of the next
+        size_t blockEnd = std::min(state.windowEnd, (state.low / blockSize + 1) * blockSize);
+        size_t idx = m_compressedKeys.lowerBound(state.low, blockEnd, state.key);
+        if (idx < state.windowEnd && m_compressedKeys.get(idx) == state.key) {
+            state.low = idx;
+            state.step = CompressedStep::ReadValue;
+            __builtin_prefetch(&m_values[idx]);
+            return true;
+        }
+        return false;
+    }
+
+    // Small enough that the rest is one or two cache lines, finish with a scan
+    const size_t linearScanSize = 64 / sizeof(std::pair<KeyType, ValueType>) + 1;
+
+    if (state.high - state.low > linearScanSize) {
+        size_t mid = state.low + (state.high - state.low) / 2;
+        if (getKey(mid) < state.key) {
+            state.low = mid + 1;
+        } else {
+            state.high = mid;
+        }
+        prefetchKey(state.low + (state.high - state.low) / 2);
+        return true;
+    }
+
+    for (size_t idx = state.low; idx < state.windowEnd && !(state.key < m_data[idx].first); ++idx) {
+        if (m_data[idx].first == state.key) {
+            result = m_data[idx];
+            break;
+        }
+    }
+    return false;
+}
+
+template <typename KeyType, typename ValueType, int secondStageSize, typename Allocator>
+void RecursiveModelIndex<KeyType, ValueType, secondStageSize, Allocator>::getSearchWindow(int stage, KeyType key,
+                                                                               size_t &startIdx, size_t &endIdx) {
+    const size_t dataSize = getDataSize();
+    long predictedIdx = m_secondStage[stage].predict(key, dataSize);
+    long start = std::max(0L, predictedIdx + m_secondStage[stage].getMaxNegativeError());
+    long end = std::min(static_cast<long>(dataSize), predictedIdx + m_secondStage[stage].getMaxPositiveError() + 1);
+
+    startIdx = static_cast<size_t>(start);
+    endIdx = static_cast<size_t>(std::max(start, end));
+}
+
+template <typename KeyType, typename ValueType, int secondStageSize, typename Allocator>
+void RecursiveModelIndex<KeyType, ValueType, secondStageSize, Allocator>::train() {
     std::cout << "Retraining..." << std::endl;
+    // Take the data back from the leaves, each node's leaves are already sorted
+    if (m_leavesBuilt) {
+        for (auto &node : m_secondStage) {
+            node.releaseLeaves(m_data);
+        }
+        m_leavesBuilt = false;
+    }
+    if (m_keysCompressed) {
+        decompressData();
+    }
+
     m_data.insert(m_data.end(), m_overflowArray.begin(), m_overflowArray.end());
 
     // Sort data
@@ -193,19 +753,407 @@ void RecursiveModelIndex<KeyType, ValueType, secondStageSize>::train() {
         return p1.first < p2.first;
     });
 
-    trainFirstStage();
+    // Loaded models replace ours only now, error bounds and trees are rebuilt for them below
+    if (m_hasPendingModels) {
+        m_explicitFirstStage = m_pendingFirstStage;
+        for (int stage = 0; stage < secondStageSize; ++stage) {
+            m_secondStage[stage].setModelWeights(m_pendingSecondStage[stage]);
+        }
+        m_pendingSecondStage.clear();
+        m_hasPendingModels = false;
+        m_useImportedModels = true;
+        m_useExplicitFirstStage = true;
+    }
+
+    m_firstStageQuantized = false;
+    if (!m_useImportedModels) {
+        trainFirstStage();
+    }
+    // Second stage models are fit on the keys the quantized first stage routes to them
+    if (m_useQuantizedInference) {
+        quantizeFirstStage();
+    }
     trainSecondStage();
+    if (m_useQuantizedInference) {
+        quantizeSecondStage();
+    }
+
+    // Rebuild the existence filter, sized for the new dataset
+    if (m_useExistenceFilter && !m_data.empty()) {
+        m_existenceFilter = BloomFilter<KeyType>(m_data.size(), m_existenceFilterParams);
+        for (const auto &pair : m_data) {
+            m_existenceFilter.insert(pair.first);
+        }
+        m_minKey = m_data.front().first;
+        m_maxKey = m_data.back().first;
+    }
 
     // Clear out overflow tree
     m_overflowArray.clear();
     m_currentOverflowSize = 0;
+
+    if (m_writeAheadLog.isOpen()) {
+        persistSnapshot();
+    }
+
+    if (m_useGappedLeaves) {
+        buildGappedLeaves();
+    } else if (m_useCompressedKeys) {
+        compressData();
+    }
+
+    // Every training buffer is gone by now, hand their memory back in one go
+    m_trainingArena.release();
+}
+
+template <typename KeyType, typename ValueType, int secondStageSize, typename Allocator>
+void RecursiveModelIndex<KeyType, ValueType, secondStageSize, Allocator>::enableExistenceFilter(const ExistenceFilterParameters &params) {
+    m_useExistenceFilter = true;
+    m_existenceFilterParams = params;
+}
+
+template <typename KeyType, typename ValueType, int secondStageSize, typename Allocator>
+void RecursiveModelIndex<KeyType, ValueType, secondStageSize, Allocator>::enableSampledBuild(const SampledBuildParameters &params) {
+    m_useSampledBuild = true;
+    m_sampledBuildParams = params;
+}
+
+template <typename KeyType, typename ValueType, int secondStageSize, typename Allocator>
+void RecursiveModelIndex<KeyType, ValueType, secondStageSize, Allocator>::enableGappedLeaves(const GappedLeafParameters &params) {
+    m_useGappedLeaves = true;
+    m_gappedLeafParams = params;
+}
+
+template <typename KeyType, typename ValueType, int secondStageSize, typename Allocator>
+void RecursiveModelIndex<KeyType, ValueType, secondStageSize, Allocator>::buildGappedLeaves() {
+    TrainingVector<int> stages{ArenaAllocator<int>(&m_trainingArena)};
+    TrainingVector<size_t> counts{ArenaAllocator<size_t>(&m_trainingArena)};
+    routeData(1, stages, counts);
+
+    auto perStageData = makePerStageBuffers<std::pair<KeyType, ValueType>>(counts);
+    for (size_t ii = 0; ii < m_data.size(); ++ii) {
+        perStageData[stages[ii]].push_back(m_data[ii]);
+    }
+
+    for (int stage = 0; stage < secondStageSize; ++stage) {
+        m_secondStage[stage].buildLeaves(perStageData[stage], m_gappedLeafParams);
+    }
+
+    // The leaves own the data now, don't keep a second copy around
+    m_data.clear();
+    m_data.shrink_to_fit();
+    m_leavesBuilt = true;
+}
+
+template <typename KeyType, typename ValueType, int secondStageSize, typename Allocator>
+void RecursiveModelIndex<KeyType, ValueType, secondStageSize, Allocator>::enableCompressedKeys() {
+    static_assert(std::is_integral<KeyType>::value, "Frame of reference encoding needs integer keys");
+    m_useCompressedKeys = true;
+}
+
+template <typename KeyType, typename ValueType, int secondStageSize, typename Allocator>
+bool RecursiveModelIndex<KeyType, ValueType, secondStageSize, Allocator>::enableWriteAheadLog(const WriteAheadLogParameters &params) {
+    if (m_writeAheadLog.isOpen()) {
+        std::cerr << "Write ahead log is already enabled" << std::endl;
+        return false;
+    }
+
+    DataVector snapshot;
+    uint64_t snapshotSequenceNumber = 0;
+    if (snapshotExists(params.snapshotPath) && !loadSnapshot(params.snapshotPath, snapshot, snapshotSequenceNumber)) {
+        return false;
+    }
+
+    // Records up to the snapshot's sequence number are already in it (we crashed before truncating the log)
+    DataVector replayed;
+    bool opened = m_writeAheadLog.open(params.logPath, params.syncBatchSize,
+                                       [&](uint64_t sequenceNumber, KeyType key, ValueType value) {
+                                           if (sequenceNumber > snapshotSequenceNumber) {
+                                               replayed.push_back({key, value});
+                                           }
+                                       });
+    if (!opened) {
+        return false;
+    }
+
+    // A log older than the snapshot must not reuse sequence numbers the snapshot covers
+    if (m_writeAheadLog.lastSequenceNumber() < snapshotSequenceNumber &&
+        !m_writeAheadLog.truncate(snapshotSequenceNumber + 1)) {
+        return false;
+    }
+
+    m_data.insert(m_data.end(), snapshot.begin(), snapshot.end());
+    for (const auto &pair : replayed) {
+        if (m_useExistenceFilter) {
+            m_existenceFilter.insert(pair.first);
+            m_minKey = std::min(m_minKey, pair.first);
+            m_maxKey = std::max(m_maxKey, pair.first);
+        }
+        m_overflowArray.push_back(pair);
+        m_currentOverflowSize++;
+    }
+    m_snapshotPath = params.snapshotPath;
+    m_maxLogRecords = params.maxLogRecords;
+    return true;
+}
+
+template <typename KeyType, typename ValueType, int secondStageSize, typename Allocator>
+bool RecursiveModelIndex<KeyType, ValueType, secondStageSize, Allocator>::syncWriteAheadLog() {
+    return m_writeAheadLog.sync();
+}
+
+template <typename KeyType, typename ValueType, int secondStageSize, typename Allocator>
+void RecursiveModelIndex<KeyType, ValueType, secondStageSize, Allocator>::persistSnapshot() {
+    // Every logged insert is stored somewhere in the index by now
+    uint64_t sequenceNumber = m_writeAheadLog.lastSequenceNumber();
+    bool saved;
+    if (!m_leavesBuilt && !m_keysCompressed && m_overflowArray.empty()) {
+        // Right after training m_data holds everything, no need to copy it
+        saved = saveSnapshot(m_snapshotPath, m_data, sequenceNumber);
+    } else {
+        DataVector data;
+        collectData(data);
+        saved = saveSnapshot(m_snapshotPath, data, sequenceNumber);
+    }
+
+    if (!saved) {
+        std::cerr << "Snapshot failed, keeping the write ahead log" << std::endl;
+        return;
+    }
+    m_writeAheadLog.truncate();
+}
+
+template <typename KeyType, typename ValueType, int secondStageSize, typename Allocator>
+void RecursiveModelIndex<KeyType, ValueType, secondStageSize, Allocator>::compressData() {
+    m_compressedKeys.build(m_data);
+    m_values.clear();
+    m_values.reserve(m_data.size());
+    for (const auto &pair : m_data) {
+        m_values.push_back(pair.second);
+    }
+
+    // Positions are unchanged, so the error bounds and trees still hold
+    m_data.clear();
+    m_data.shrink_to_fit();
+    m_keysCompressed = true;
+}
+
+template <typename KeyType, typename ValueType, int secondStageSize, typename Allocator>
+void RecursiveModelIndex<KeyType, ValueType, secondStageSize, Allocator>::decompressData() {
+    m_data.reserve(m_compressedKeys.size() + m_overflowArray.size());
+    for (size_t ii = 0; ii < m_compressedKeys.size(); ++ii) {
+        m_data.push_back({m_compressedKeys.get(ii), m_values[ii]});
+    }
+
+    m_compressedKeys.clear();
+    m_values.clear();
+    m_values.shrink_to_fit();
+    m_keysCompressed = false;
+}
+
+template <typename KeyType, typename ValueType, int secondStageSize, typename Allocator>
+void RecursiveModelIndex<KeyType, ValueType, secondStageSize, Allocator>::routeData(size_t stride, TrainingVector<int> &stages,
+                                                                         TrainingVector<size_t> &counts) {
+    stages.clear();
+    stages.reserve((m_data.size() + stride - 1) / stride);
+    counts.assign(secondStageSize, 0);
+    for (size_t ii = 0; ii < m_data.size(); ii += stride) {
+        int stage = getStage(m_data[ii].first);
+        stages.push_back(stage);
+        counts[stage]++;
+    }
+}
+
+template <typename KeyType, typename ValueType, int secondStageSize, typename Allocator>
+int RecursiveModelIndex<KeyType, ValueType, secondStageSize, Allocator>::getStage(KeyType key) {
+    if (m_firstStageQuantized) {
+        int64_t stage = m_quantizedFirstStage.predict(key);
+        return static_cast<int>(std::max<int64_t>(0, std::min<int64_t>(secondStageSize - 1, stage)));
+    }
+
+    // If we take the result (unscaled, so closer to 0-1), and multiply by the
+    // number of stages we get an assignment
+    int stage = static_cast<int>(evaluateFirstStage(key) * secondStageSize);
+
+    // Cap the range of stages to 0 -> (secondStageSize - 1)
+    stage = std::max(0, stage);
+    stage = std::min(secondStageSize - 1, stage);
+    return stage;
+}
+
+template <typename KeyType, typename ValueType, int secondStageSize, typename Allocator>
+float RecursiveModelIndex<KeyType, ValueType, secondStageSize, Allocator>::evaluateFirstStage(KeyType key) {
+    if (m_useExplicitFirstStage) {
+        return m_explicitFirstStage.predict(static_cast<float>(key));
+    }
+
+    m_routingInput(0, 0) = static_cast<float>(key);
+    auto result = m_firstStageNetwork->forward<2, 2>(m_routingInput);
+    return result(0, 0);
+}
+
+template <typename KeyType, typename ValueType, int secondStageSize, typename Allocator>
+bool RecursiveModelIndex<KeyType, ValueType, secondStageSize, Allocator>::loadModels(const std::string &path) {
+    FirstStageWeights firstStage;
+    std::vector<LinearModelWeights> secondStage;
+    if (!loadModelWeights(path, firstStage, secondStage)) {
+        return false;
+    }
+
+    if (secondStage.size() != secondStageSize) {
+        std::cerr << "Weight file " << path << " has " << secondStage.size() << " second stage nodes, expected "
+                  << secondStageSize << std::endl;
+        return false;
+    }
+
+    // Bounds, trees and leaves were built for the current models, so they keep routing keys until the next train()
+    m_pendingFirstStage = firstStage;
+    m_pendingSecondStage = secondStage;
+    m_hasPendingModels = true;
+    return true;
+}
+
+template <typename KeyType, typename ValueType, int secondStageSize, typename Allocator>
+bool RecursiveModelIndex<KeyType, ValueType, secondStageSize, Allocator>::saveModels(const std::string &path) {
+    if (!m_useExplicitFirstStage) {
+        std::cerr << "The first stage network's parameters can't be read, enable parallel training to save models" << std::endl;
+        return false;
+    }
+
+    // Each node's model is read off over the keys routed to it
+    DataVector data;
+    collectData(data);
+    std::vector<std::pair<KeyType, KeyType>> keyRanges(secondStageSize);
+    std::vector<bool> hasKeys(secondStageSize, false);
+    for (const auto &pair : data) {
+        int stage = getStage(pair.first);
+        if (!hasKeys[stage]) {
+            keyRanges[stage] = {pair.first, pair.first};
+            hasKeys[stage] = true;
+        }
+        keyRanges[stage].first = std::min(keyRanges[stage].first, pair.first);
+        keyRanges[stage].second = std::max(keyRanges[stage].second, pair.first);
+    }
+
+    std::vector<LinearModelWeights> secondStage(secondStageSize);
+    for (int stage = 0; stage < secondStageSize; ++stage) {
+        if (hasKeys[stage]) {
+            secondStage[stage] = m_secondStage[stage].getModelWeights(keyRanges[stage].first, keyRanges[stage].second);
+        }
+    }
+    return saveModelWeights(path, m_explicitFirstStage, secondStage);
+}
+
+template <typename KeyType, typename ValueType, int secondStageSize, typename Allocator>
+void RecursiveModelIndex<KeyType, ValueType, secondStageSize, Allocator>::collectData(DataVector &output) const {
+    if (m_leavesBuilt) {
+        for (const auto &node : m_secondStage) {
+            node.collectLeaves(output);
+        }
+    } else if (m_keysCompressed) {
+        output.reserve(output.size() + m_compressedKeys.size() + m_overflowArray.size());
+        for (size_t ii = 0; ii < m_compressedKeys.size(); ++ii) {
+            output.push_back(getEntry(ii));
+        }
+    } else {
+        output.insert(output.end(), m_data.begin(), m_data.end());
+    }
+    output.insert(output.end(), m_overflowArray.begin(), m_overflowArray.end());
+}
+
+template <typename KeyType, typename ValueType, int secondStageSize, typename Allocator>
+void RecursiveModelIndex<KeyType, ValueType, secondStageSize, Allocator>::enableParallelTraining(const ParallelTrainingParameters &params) {
+    m_useParallelTraining = true;
+    m_parallelTrainingParams = params;
+}
+
+template <typename KeyType, typename ValueType, int secondStageSize, typename Allocator>
+void RecursiveModelIndex<KeyType, ValueType, secondStageSize, Allocator>::enableQuantizedInference() {
+    static_assert(std::is_integral<KeyType>::value, "Fixed point models need integer keys");
+    m_useQuantizedInference = true;
+}
+
+template <typename KeyType, typename ValueType, int secondStageSize, typename Allocator>
+void RecursiveModelIndex<KeyType, ValueType, secondStageSize, Allocator>::quantizeFirstStage() {
+    if (m_data.empty() || !m_useExplicitFirstStage) {
+        return;
+    }
+
+    m_quantizedFirstStage = QuantizedPiecewiseLinearModelFor<KeyType>::fromFirstStage(
+            m_explicitFirstStage, secondStageSize, m_data.front().first, m_data.back().first);
+    m_firstStageQuantized = true;
+}
+
+template <typename KeyType, typename ValueType, int secondStageSize, typename Allocator>
+void RecursiveModelIndex<KeyType, ValueType, secondStageSize, Allocator>::quantizeSecondStage() {
+    // Each node's model only has to cover the keys routed to it, and m_data is sorted
+    std::array<size_t, secondStageSize> firstIdx, lastIdx;
+    firstIdx.fill(m_data.size());
+    for (size_t ii = 0; ii < m_data.size(); ++ii) {
+        int stage = getStage(m_data[ii].first);
+        if (firstIdx[stage] == m_data.size()) {
+            firstIdx[stage] = ii;
+        }
+        lastIdx[stage] = ii;
+    }
+
+    for (int stage = 0; stage < secondStageSize; ++stage) {
+        if (firstIdx[stage] < m_data.size()) {
+            m_secondStage[stage].quantize(m_data[firstIdx[stage]].first, m_data[lastIdx[stage]].first, m_data.size());
+        }
+    }
+    computeSecondStageErrorBounds();
+}
+
+template <typename KeyType, typename ValueType, int secondStageSize, typename Allocator>
+size_t RecursiveModelIndex<KeyType, ValueType, secondStageSize, Allocator>::getSampleStride() const {
+    if (!m_useSampledBuild) {
+        return 1;
+    }
+
+    size_t sampleSize = static_cast<size_t>(m_data.size() * m_sampledBuildParams.sampleFraction);
+    sampleSize = std::max(sampleSize, m_sampledBuildParams.minSampleSize);
+    // The first stage needs at least a full batch to train on
+    sampleSize = std::max(sampleSize, static_cast<size_t>(m_firstStageParams.batchSize));
+
+    if (sampleSize >= m_data.size()) {
+        return 1;
+    }
+    return m_data.size() / sampleSize;
 }
 
-template <typename KeyType, typename ValueType, int secondStageSize>
-void RecursiveModelIndex<KeyType, ValueType, secondStageSize>::trainFirstStage() {
+template <typename KeyType, typename ValueType, int secondStageSize, typename Allocator>
+void RecursiveModelIndex<KeyType, ValueType, secondStageSize, Allocator>::trainFirstStage() {
     // TODO: Do we want to clear out the old network or use it's previous weights?
     std::cout << "Training first stage" << std::endl;
 
+    // Sorted data means every stride-th key is an evenly spaced quantile of the CDF
+    const size_t stride = getSampleStride();
+    const size_t sampleSize = (m_data.size() + stride - 1) / stride;
+
+    if (m_useParallelTraining || m_useQuantizedInference) {
+        TrainingVector<float> keys{ArenaAllocator<float>(&m_trainingArena)};
+        TrainingVector<float> positions{ArenaAllocator<float>(&m_trainingArena)};
+        keys.reserve(sampleSize);
+        positions.reserve(sampleSize);
+        for (size_t idx = 0; idx < m_data.size(); idx += stride) {
+            keys.push_back(static_cast<float>(m_data[idx].first));
+            positions.push_back(static_cast<float>(idx));
+        }
+
+        // Quantization only needs the parameters, it doesn't ask for more threads than the network would use
+        ParallelTrainingParameters trainingParams = m_parallelTrainingParams;
+        if (!m_useParallelTraining) {
+            trainingParams.numThreads = 1;
+        }
+
+        FirstStageTrainer trainer(m_firstStageParams, trainingParams);
+        m_explicitFirstStage = trainer.train(keys.data(), positions.data(), sampleSize, m_data.size());
+        m_useExplicitFirstStage = true;
+        return;
+    }
+    m_useExplicitFirstStage = false;
+
     // Huber loss is used for increased stability
     nn::HuberLoss<float, 2> lossFunction;
 
@@ -214,16 +1162,19 @@ void RecursiveModelIndex<KeyType, ValueType, secondStageSize>::trainFirstStage()
 
     Eigen::Tensor<float, 2> input(m_firstStageParams.batchSize, 1);
     Eigen::Tensor<float, 2> positions(m_firstStageParams.batchSize, 1);
+    BatchSampler sampler(m_firstStageParams.batchSize, sampleSize, m_firstStageParams.seed,
+                         m_firstStageParams.fullPassEpochs);
+    const size_t numIterations = m_firstStageParams.maxNumEpochs * sampler.batchesPerEpoch();
 
-    for (int currentEpoch = 0; currentEpoch < m_firstStageParams.maxNumEpochs; ++currentEpoch) {
-        auto newBatch = getRandomBatch<KeyType>(m_firstStageParams.batchSize, m_data.size());
-        int ii = 0;
-        for (auto idx : newBatch) {
+    for (size_t iteration = 0; iteration < numIterations; ++iteration) {
+        const size_t currentEpoch = iteration / sampler.batchesPerEpoch();
+        const auto &newBatch = sampler.nextBatch();
+        for (int ii = 0; ii < m_firstStageParams.batchSize; ++ii) {
+            const size_t idx = newBatch[ii] * stride;
             // Input is the key
             input(ii, 0) = static_cast<float>(m_data[idx].first);
             // Label is the position in our sorted array
             positions(ii, 0) = static_cast<float>(idx);
-            ii++;
         }
 
         auto result = m_firstStageNetwork->forward<2, 2>(input);
@@ -243,35 +1194,103 @@ void RecursiveModelIndex<KeyType, ValueType, secondStageSize>::trainFirstStage()
     }
 }
 
-template <typename KeyType, typename ValueType, int secondStageSize>
-void RecursiveModelIndex<KeyType, ValueType, secondStageSize>::trainSecondStage() {
-    std::cout << "Creating per stage dataset" << std::endl;
+template <typename KeyType, typename ValueType, int secondStageSize, typename Allocator>
+void RecursiveModelIndex<KeyType, ValueType, secondStageSize, Allocator>::trainSecondStage() {
+    // Imported models only need their error bounds against the current data
+    if (m_useImportedModels) {
+        computeSecondStageErrorBounds();
+        return;
+    }
 
-    // Create training sets for second stage models
-    std::array<std::vector<std::pair<KeyType, size_t>>, secondStageSize> perStageDataset;
-    Eigen::Tensor<float, 2> predictInput(1, 1);
-    for (int ii = 0; ii < m_data.size(); ++ii) {
-        predictInput(0, 0) = static_cast<float>(m_data[ii].first);
+    if (getSampleStride() > 1) {
+        trainSecondStageSampled();
+        return;
+    }
 
-        // Get result from first stage, and then scale
-        auto result = m_firstStageNetwork->forward<2, 2>(predictInput);
-        auto resultIdx = result * result.constant(m_data.size());
+    std::cout << "Creating per stage dataset" << std::endl;
 
-        // Calculate which stage we want to send this data to
-        // If we take the result (unscaled, so closer to 0-1), and multiply by the
-        // number of stages we get an assignment
-        int stage = static_cast<int>(result(0, 0) * secondStageSize);
+    // Create training sets for second stage models
+    TrainingVector<int> stages{ArenaAllocator<int>(&m_trainingArena)};
+    TrainingVector<size_t> counts{ArenaAllocator<size_t>(&m_trainingArena)};
+    routeData(1, stages, counts);
 
-        // Cap the range of stages to 0 -> (secondStageSize - 1)
-        stage = std::max(0, stage);
-        stage = std::min(secondStageSize - 1, stage);
-        perStageDataset[stage].push_back({m_data[ii].first, ii});
+    auto perStageDataset = makePerStageBuffers<std::pair<KeyType, size_t>>(counts);
+    for (size_t ii = 0; ii < m_data.size(); ++ii) {
+        perStageDataset[stages[ii]].push_back({m_data[ii].first, ii});
     }
 
     std::cout << "Training second stage" << std::endl;
     // Train each stage
     for (int stage = 0; stage < secondStageSize; ++stage) {
-        m_secondStage[stage].train(perStageDataset[stage], m_secondStageParams, m_data.size());
+        // Give each node its own sampling seed so nodes don't all draw the same batches
+        NetworkParameters nodeParams = m_secondStageParams;
+        nodeParams.seed += stage;
+        m_secondStage[stage].train(perStageDataset[stage], nodeParams, m_data.size());
+    }
+}
+
+template <typename KeyType, typename ValueType, int secondStageSize, typename Allocator>
+void RecursiveModelIndex<KeyType, ValueType, secondStageSize, Allocator>::trainSecondStageSampled() {
+    const size_t stride = getSampleStride();
+    std::cout << "Creating per stage sample (every " << stride << " keys)" << std::endl;
+
+    TrainingVector<int> stages{ArenaAllocator<int>(&m_trainingArena)};
+    TrainingVector<size_t> counts{ArenaAllocator<size_t>(&m_trainingArena)};
+    routeData(stride, stages, counts);
+
+    auto perStageSample = makePerStageBuffers<std::pair<KeyType, size_t>>(counts);
+    for (size_t ii = 0; ii < m_data.size(); ii += stride) {
+        perStageSample[stages[ii / stride]].push_back({m_data[ii].first, ii});
+    }
+
+    std::cout << "Training second stage on sample" << std::endl;
+    for (int stage = 0; stage < secondStageSize; ++stage) {
+        NetworkParameters nodeParams = m_secondStageParams;
+        nodeParams.seed += stage;
+        m_secondStage[stage].fitModel(perStageSample[stage], nodeParams, m_data.size());
+    }
+
+    computeSecondStageErrorBounds();
+}
+
+template <typename KeyType, typename ValueType, int secondStageSize, typename Allocator>
+void RecursiveModelIndex<KeyType, ValueType, secondStageSize, Allocator>::computeSecondStageErrorBounds() {
+    for (auto &node : m_secondStage) {
+        node.resetErrorBounds();
+    }
+
+    // One streaming pass over all the data makes the error bounds exact
+    std::cout << "Computing second stage error bounds" << std::endl;
+    TrainingVector<int> stages{ArenaAllocator<int>(&m_trainingArena)};
+    TrainingVector<size_t> counts{ArenaAllocator<size_t>(&m_trainingArena)};
+    routeData(1, stages, counts);
+    for (size_t ii = 0; ii < m_data.size(); ++ii) {
+        m_secondStage[stages[ii]].updateErrorBounds(m_data[ii].first, ii, m_data.size());
+    }
+
+    std::array<bool, secondStageSize> needsTree;
+    bool anyNeedsTree = false;
+    for (int stage = 0; stage < secondStageSize; ++stage) {
+        needsTree[stage] = m_secondStage[stage].isValid() && m_secondStage[stage].finishErrorBounds();
+        anyNeedsTree = anyNeedsTree || needsTree[stage];
+    }
+
+    // Only nodes that fell back to a tree need their keys, so only then do we pay for a second pass
+    if (anyNeedsTree) {
+        for (int stage = 0; stage < secondStageSize; ++stage) {
+            counts[stage] = needsTree[stage] ? counts[stage] : 0;
+        }
+        auto treeData = makePerStageBuffers<std::pair<KeyType, size_t>>(counts);
+        for (size_t ii = 0; ii < m_data.size(); ++ii) {
+            if (needsTree[stages[ii]]) {
+                treeData[stages[ii]].push_back({m_data[ii].first, ii});
+            }
+        }
+        for (int stage = 0; stage < secondStageSize; ++stage) {
+            if (needsTree[stage]) {
+                m_secondStage[stage].buildTree(treeData[stage]);
+            }
+        }
     }
 }
 
@@ -12,8 +12,11 @@
 
 #include "../external/nn_cpp/nn/Net.h"
 #include "../external/cpp-btree/btree_map.h"
+#include "GappedArray.h"
 #include "utils/DataUtils.h"
+#include "utils/ModelWeights.h"
 #include "utils/NetworkParameters.h"
+#include "utils/QuantizedModel.h"
 #include <boost/optional.hpp>
 
 // TODO: This doesn't protect against calling tree related funcs if no tree
@@ -22,8 +25,9 @@
 /**
  * @brief A wrapper around the second stage (either network or btree)
  * @tparam KeyType [in]: Keytype of the stage
+ * @tparam ValueType [in]: Value type stored in the node's gapped array leaves (if used)
  */
-template <typename KeyType>
+template <typename KeyType, typename ValueType = size_t>
 class SecondStageNode {
 public:
 
@@ -59,9 +63,32 @@ public:
      * @brief Predict a location with the network
      * @param key [in]: Key to use as input
      * @param totalDatasetSize [in]: The dataset size of the WHOLE dataset
-     * @return A predicted location
+     * @return A predicted location (can be negative or past the end, the error bounds correct for it)
      */
-    size_t predict(KeyType key, size_t totalDatasetSize);
+    long predict(KeyType key, size_t totalDatasetSize);
+
+    /**
+     * @brief Predict with fixed, pre-trained parameters instead of the network, until the next fitModel
+     * @param weights [in]: The model parameters
+     */
+    void setModelWeights(const LinearModelWeights &weights);
+
+    /**
+     * @brief Get the parameters of the float model, e.g. to export them
+     * @param minKey [in]: Smallest key routed to this node
+     * @param maxKey [in]: Largest key routed to this node
+     * @return The imported parameters, or the network's, recovered from its predictions at minKey and maxKey
+     */
+    LinearModelWeights getModelWeights(KeyType minKey, KeyType maxKey);
+
+    /**
+     * @brief Predict with a fixed point copy of the model from now on, until the next fitModel or setModelWeights.
+     * Error bounds must be recomputed afterwards
+     * @param minKey [in]: Smallest key routed to this node
+     * @param maxKey [in]: Largest key routed to this node
+     * @param totalDatasetSize [in]: The size of the WHOLE dataset
+     */
+    void quantize(KeyType minKey, KeyType maxKey, size_t totalDatasetSize);
 
     /**
      * @brief Train this stages network
@@ -69,7 +96,43 @@ public:
      * @param trainingParameters [in]: The current network parameters
      * @param totalDatasetSize [in]: The size of the WHOLE dataset
      */
-    void train(const std::vector<std::pair<KeyType, size_t>> &data, const NetworkParameters &trainingParameters, size_t totalDatasetSize);
+    template <typename DataAllocator>
+    void train(const std::vector<std::pair<KeyType, size_t>, DataAllocator> &data, const NetworkParameters &trainingParameters, size_t totalDatasetSize);
+
+    /**
+     * @brief Fit this stages network without computing error bounds
+     * @param data [in]: A reference to the training data (key, idx), can be a sample of the node's keys
+     * @param trainingParameters [in]: The current network parameters
+     * @param totalDatasetSize [in]: The size of the WHOLE dataset
+     */
+    template <typename DataAllocator>
+    void fitModel(const std::vector<std::pair<KeyType, size_t>, DataAllocator> &data, const NetworkParameters &trainingParameters, size_t totalDatasetSize);
+
+    /**
+     * @brief Start a new pass of error bound computation
+     */
+    void resetErrorBounds();
+
+    /**
+     * @brief Grow the error bounds to cover one of this node's keys
+     * @param key [in]: A key routed to this node
+     * @param idx [in]: The position of the key in the sorted data
+     * @param totalDatasetSize [in]: The size of the WHOLE dataset
+     */
+    void updateErrorBounds(KeyType key, size_t idx, size_t totalDatasetSize);
+
+    /**
+     * @brief Finish an error bound pass and decide if the error is too large for the network
+     * @return Whether this node needs a tree (filled with buildTree)
+     */
+    bool finishErrorBounds();
+
+    /**
+     * @brief Fill the fallback tree with all of this node's keys
+     * @param data [in]: Every (key, idx) routed to this node
+     */
+    template <typename DataAllocator>
+    void buildTree(const std::vector<std::pair<KeyType, size_t>, DataAllocator> &data);
 
     /**
      * @return Whether to use the tree
@@ -85,7 +148,70 @@ public:
      */
     boost::optional<std::pair<KeyType, size_t>> treeFind(KeyType key);
 
+    /**
+     * @brief Store this node's keys and values in gapped array leaves, which take inserts in place
+     * @param data [in]: Every (key, value) routed to this node, sorted by key
+     * @param params [in]: Density and size thresholds of the leaves
+     */
+    template <typename DataAllocator>
+    void buildLeaves(const std::vector<std::pair<KeyType, ValueType>, DataAllocator> &data, const GappedLeafParameters &params);
+
+    /**
+     * @return Whether this node stores its data in gapped array leaves
+     */
+    bool hasLeaves() {
+        return !m_leaves.empty();
+    }
+
+    /**
+     * @brief Insert into the leaf covering the key, splitting it if it grew past maxLeafSize
+     * @param key [in]: The key to insert
+     * @param value [in]: The value to insert
+     */
+    void leafInsert(KeyType key, ValueType value);
+
+    /**
+     * @brief Find a key in this node's leaves
+     * @param key [in]: The key to search for
+     * @return The (key, value) pair if found
+     */
+    boost::optional<std::pair<KeyType, ValueType>> leafFind(KeyType key) {
+        return m_leaves[getLeafIndex(key)].find(key);
+    }
+
+    /**
+     * @brief Copy everything in the leaves, keeping them
+     * @param output [out]: Where to append the (key, value) pairs, sorted by key
+     */
+    template <typename DataAllocator>
+    void collectLeaves(std::vector<std::pair<KeyType, ValueType>, DataAllocator> &output) const {
+        for (const auto &leaf : m_leaves) {
+            leaf.collect(output);
+        }
+    }
+
+    /**
+     * @brief Move everything out of the leaves, leaving the node without leaves
+     * @param output [out]: Where to append the (key, value) pairs, sorted by key
+     */
+    template <typename DataAllocator>
+    void releaseLeaves(std::vector<std::pair<KeyType, ValueType>, DataAllocator> &output);
+
 private:
+
+    /**
+     * @brief Evaluate the model (network or imported parameters)
+     * @return The predicted position divided by the dataset size
+     */
+    float evaluate(KeyType key);
+
+    /**
+     * @brief Find which leaf covers a key
+     */
+    size_t getLeafIndex(KeyType key) {
+        return std::upper_bound(m_leafLowerBounds.begin(), m_leafLowerBounds.end(), key) - m_leafLowerBounds.begin();
+    }
+
     bool m_useTree;                           ///< Whether to use the tree or not
     int m_positionErrorThreshold;             ///< The max position error before swapping to a BTree
     bool m_nodeIsValid;                       ///< Whether this node is valid (has data)
@@ -94,23 +220,35 @@ private:
     std::unique_ptr<nn::Net<float>> m_net;    ///< Our network for this stage
     int m_maxNegativeError;                   ///< Max error (negative) of a prediction
     int m_maxPositiveError;                   ///< Max error (positive) of a prediction
+    long m_maxAbsoluteError;                  ///< Max absolute error of a prediction
+    Eigen::Tensor<float, 2> m_modelInput;     ///< Reused network input for predictions
+    bool m_useImportedModel;                  ///< Whether to predict with m_importedModel instead of the network
+    LinearModelWeights m_importedModel;       ///< Model parameters set with setModelWeights
+    bool m_useQuantizedModel;                 ///< Whether to predict with m_quantizedModel
+    QuantizedLinearModelFor<KeyType> m_quantizedModel;  ///< Fixed point model set with quantize, predicts positions
 
     /// Tree related items
     btree::btree_map<KeyType, size_t> m_tree; ///< The tree if needed
+
+    /// Gapped array leaf items
+    GappedLeafParameters m_leafParams;                       ///< Density and size thresholds of the leaves
+    std::vector<GappedArray<KeyType, ValueType>> m_leaves;   ///< Leaves, ordered by key range
+    std::vector<KeyType> m_leafLowerBounds;                  ///< Smallest key of every leaf but the first
 };
 
-template <typename KeyType>
-SecondStageNode<KeyType>::SecondStageNode(int positionErrorThreshold, int netBatchSize):
+template <typename KeyType, typename ValueType>
+SecondStageNode<KeyType, ValueType>::SecondStageNode(int positionErrorThreshold, int netBatchSize):
     m_useTree(false), m_positionErrorThreshold(positionErrorThreshold), m_nodeIsValid(false),
-    m_maxNegativeError(0), m_maxPositiveError(0)
+    m_maxNegativeError(0), m_maxPositiveError(0), m_maxAbsoluteError(0), m_modelInput(1, 1),
+    m_useImportedModel(false), m_useQuantizedModel(false)
 {
     // Init net
     m_net.reset(new nn::Net<float>());
     m_net->add(new nn::Dense<float, 2>(netBatchSize, 1, 1, true, nn::InitializationScheme::GlorotNormal));
 }
 
-template <typename KeyType>
-boost::optional<std::pair<KeyType, size_t>> SecondStageNode<KeyType>::treeFind(KeyType key) {
+template <typename KeyType, typename ValueType>
+boost::optional<std::pair<KeyType, size_t>> SecondStageNode<KeyType, ValueType>::treeFind(KeyType key) {
     assert(m_useTree && "Called treeFind but the tree isn't supposed to be used");
     auto result = m_tree.find(key);
     if (result != m_tree.end()) {
@@ -120,19 +258,85 @@ boost::optional<std::pair<KeyType, size_t>> SecondStageNode<KeyType>::treeFind(K
     }
 }
 
-template <typename KeyType>
-size_t SecondStageNode<KeyType>::predict(KeyType key, size_t totalDatasetSize) {
-    Eigen::Tensor<float, 2> input(1, 1);
-    input(0, 0) = static_cast<float>(key);
+template <typename KeyType, typename ValueType>
+long SecondStageNode<KeyType, ValueType>::predict(KeyType key, size_t totalDatasetSize) {
+    if (m_useQuantizedModel) {
+        return static_cast<long>(m_quantizedModel.predict(key));
+    }
+    return static_cast<long>(evaluate(key) * static_cast<float>(totalDatasetSize));
+}
+
+template <typename KeyType, typename ValueType>
+float SecondStageNode<KeyType, ValueType>::evaluate(KeyType key) {
+    if (m_useImportedModel) {
+        return m_importedModel.predict(static_cast<float>(key));
+    }
+
+    m_modelInput(0, 0) = static_cast<float>(key);
+    auto result = m_net->forward<2, 2>(m_modelInput);
+    return result(0, 0);
+}
+
+template <typename KeyType, typename ValueType>
+void SecondStageNode<KeyType, ValueType>::setModelWeights(const LinearModelWeights &weights) {
+    m_importedModel = weights;
+    m_useImportedModel = true;
+    m_useQuantizedModel = false;
+}
+
+template <typename KeyType, typename ValueType>
+void SecondStageNode<KeyType, ValueType>::quantize(KeyType minKey, KeyType maxKey, size_t totalDatasetSize) {
+    // The model is linear, so two evaluations recover it whether it is the network or imported parameters
+    double lowValue = static_cast<double>(evaluate(minKey)) * totalDatasetSize;
+    double highValue = static_cast<double>(evaluate(maxKey)) * totalDatasetSize;
+    double slope = maxKey > minKey ? (highValue - lowValue) / (static_cast<double>(maxKey) - static_cast<double>(minKey)) : 0;
+
+    m_quantizedModel = QuantizedLinearModelFor<KeyType>::fit(slope, lowValue, minKey, maxKey);
+    m_useQuantizedModel = true;
+}
+
+template <typename KeyType, typename ValueType>
+LinearModelWeights SecondStageNode<KeyType, ValueType>::getModelWeights(KeyType minKey, KeyType maxKey) {
+    if (m_useImportedModel) {
+        return m_importedModel;
+    }
+
+    // nn_cpp doesn't expose the network's parameters, but the model is linear, so two predictions recover it.
+    // Predicting at the node's own keys keeps the recovered model accurate where it is used
+    double lowValue = evaluate(minKey);
+    double highValue = evaluate(maxKey);
+    double slope = maxKey > minKey ? (highValue - lowValue) / (static_cast<double>(maxKey) - static_cast<double>(minKey)) : 0;
 
-    auto result = m_net->forward<2, 2>(input);
-    result = result * result.constant(totalDatasetSize);
-    return static_cast<size_t>(result(0, 0));
+    LinearModelWeights weights;
+    weights.weight = static_cast<float>(slope);
+    weights.bias = static_cast<float>(lowValue - slope * static_cast<double>(minKey));
+    return weights;
 }
 
-template <typename KeyType>
-void SecondStageNode<KeyType>::train(const std::vector<std::pair<KeyType, size_t>> &data,
+template <typename KeyType, typename ValueType>
+template <typename DataAllocator>
+void SecondStageNode<KeyType, ValueType>::train(const std::vector<std::pair<KeyType, size_t>, DataAllocator> &data,
                                  const NetworkParameters &trainingParameters, size_t totalDatasetSize) {
+    fitModel(data, trainingParameters, totalDatasetSize);
+    if (!m_nodeIsValid) {
+        return;
+    }
+
+    // Now calculate our error
+    resetErrorBounds();
+    for (size_t ii = 0; ii < data.size(); ++ii) {
+        updateErrorBounds(data[ii].first, data[ii].second, totalDatasetSize);
+    }
+
+    if (finishErrorBounds()) {
+        buildTree(data);
+    }
+}
+
+template <typename KeyType, typename ValueType>
+template <typename DataAllocator>
+void SecondStageNode<KeyType, ValueType>::fitModel(const std::vector<std::pair<KeyType, size_t>, DataAllocator> &data,
+                                        const NetworkParameters &trainingParameters, size_t totalDatasetSize) {
     size_t trainingDatasetSize = data.size();
 
     if (trainingDatasetSize == 0) {
@@ -143,6 +347,9 @@ void SecondStageNode<KeyType>::train(const std::vector<std::pair<KeyType, size_t
     }
     // If we have data, we have a valid node
     m_nodeIsValid = true;
+    // Fitting replaces any imported or quantized model
+    m_useImportedModel = false;
+    m_useQuantizedModel = false;
 
     // Make sure batchSize is <= dataset size
     int batchSize = std::min(trainingParameters.batchSize, static_cast<int>(trainingDatasetSize));
@@ -159,17 +366,19 @@ void SecondStageNode<KeyType>::train(const std::vector<std::pair<KeyType, size_t
     Eigen::Tensor<float, 2> positions(batchSize, 1);
     nn::HuberLoss<float, 2> lossFunc;
 
+    BatchSampler sampler(batchSize, trainingDatasetSize, trainingParameters.seed, trainingParameters.fullPassEpochs);
+    const size_t numIterations = trainingParameters.maxNumEpochs * sampler.batchesPerEpoch();
+
     // Train this stage
-    for (int currentEpoch = 0; currentEpoch < trainingParameters.maxNumEpochs; ++currentEpoch) {
-        auto newBatch = getRandomBatch<KeyType>(batchSize, trainingDatasetSize);
-        int ii = 0;
-        for (auto idx : newBatch) {
+    for (size_t iteration = 0; iteration < numIterations; ++iteration) {
+        const auto &newBatch = sampler.nextBatch();
+        for (int ii = 0; ii < batchSize; ++ii) {
+            const size_t idx = newBatch[ii];
             // In this stage, perStageDataset is pair {key, idx}
             // Input is the key
             input(ii, 0) = static_cast<float>(data[idx].first);
             // Label is the position in our sorted array
             positions(ii, 0) = static_cast<float>(data[idx].second);
-            ii++;
         }
 
         auto result = m_net->forward<2, 2>(input);
@@ -179,55 +388,127 @@ void SecondStageNode<KeyType>::train(const std::vector<std::pair<KeyType, size_t
         auto lossBack = lossFunc.backward(result, positions);
 
         // TODO: Add logging, make debug message
-//        std::cout << "Epoch: " << currentEpoch << " loss: " << loss << std::endl;
+//        std::cout << "Iteration: " << iteration << " loss: " << loss << std::endl;
         lossBack = lossBack / lossBack.constant(totalDatasetSize);
 
         m_net->backward<2>(lossBack);
         m_net->step();
     }
+}
 
-    // Now calculate our error
-    Eigen::Tensor<float, 2> testInput(1, 1);
-    long currentMaxAbsoluteError = 0;
+template <typename KeyType, typename ValueType>
+void SecondStageNode<KeyType, ValueType>::resetErrorBounds() {
+    // Only nodes that see a key in this pass are valid
+    m_nodeIsValid = false;
     m_maxNegativeError = 0;
     m_maxPositiveError = 0;
+    m_maxAbsoluteError = 0;
+}
+
+template <typename KeyType, typename ValueType>
+void SecondStageNode<KeyType, ValueType>::updateErrorBounds(KeyType key, size_t idx, size_t totalDatasetSize) {
+    // Keys can reach a node the model was never fit on (e.g. when fit on a sample)
+    m_nodeIsValid = true;
 
-    for (int ii = 0; ii < trainingDatasetSize; ++ii) {
-        const KeyType &key = data[ii].first;
-        const size_t &idx = data[ii].second;
-        testInput(0, 0) = static_cast<float>(key);
+    long predictedIdx = predict(key, totalDatasetSize);
+    auto error = static_cast<long>(idx) - predictedIdx;
 
-        auto result = m_net->forward<2, 2>(testInput);
-        result = result * result.constant(totalDatasetSize);
+    if (error < m_maxNegativeError) {
+        m_maxNegativeError = error;
+    }
+    if (error > m_maxPositiveError) {
+        m_maxPositiveError = error;
+    }
 
-        long predictedIdx = static_cast<long>(result(0, 0));
-        auto error = static_cast<long>(idx) - predictedIdx;
+    auto absError = std::abs(error);
+    if (absError > m_maxAbsoluteError) {
+        m_maxAbsoluteError = absError;
+    }
+}
 
-        if (error < m_maxNegativeError) {
-            m_maxNegativeError = error;
-        }
-        if (error > m_maxPositiveError) {
-            m_maxPositiveError = error;
+template <typename KeyType, typename ValueType>
+bool SecondStageNode<KeyType, ValueType>::finishErrorBounds() {
+    m_useTree = m_maxAbsoluteError > m_positionErrorThreshold;
+
+    std::cout << "Absolute max error: " << m_maxAbsoluteError;
+    std::cout << " Max Negative: " << m_maxNegativeError;
+    std::cout << " Max Positive: " << m_maxPositiveError << std::endl;
+
+    return m_useTree;
+}
+
+template <typename KeyType, typename ValueType>
+template <typename DataAllocator>
+void SecondStageNode<KeyType, ValueType>::buildTree(const std::vector<std::pair<KeyType, size_t>, DataAllocator> &data) {
+    m_tree.clear();
+    for (size_t ii = 0; ii < data.size(); ++ii) {
+        m_tree.insert(data[ii]);
+    }
+}
+
+template <typename KeyType, typename ValueType>
+template <typename DataAllocator>
+void SecondStageNode<KeyType, ValueType>::buildLeaves(const std::vector<std::pair<KeyType, ValueType>, DataAllocator> &data,
+                                                      const GappedLeafParameters &params) {
+    m_leafParams = params;
+    m_leaves.clear();
+    m_leafLowerBounds.clear();
+
+    // Start leaves half full so they can take inserts before splitting
+    size_t leafSize = std::max(m_leafParams.maxLeafSize / 2, static_cast<size_t>(1));
+    size_t start = 0;
+    do {
+        size_t end = std::min(start + leafSize, data.size());
+        // Never split a run of equal keys across leaves
+        while (end < data.size() && end > start && data[end].first == data[end - 1].first) {
+            ++end;
         }
 
-        auto absError = std::abs(error);
-        if (absError > currentMaxAbsoluteError) {
-            currentMaxAbsoluteError = absError;
+        if (start > 0) {
+            m_leafLowerBounds.push_back(data[start].first);
         }
+        m_leaves.emplace_back(m_leafParams);
+        m_leaves.back().bulkLoad(std::vector<std::pair<KeyType, ValueType>>(data.begin() + start, data.begin() + end));
+        start = end;
+    } while (start < data.size());
+}
+
+template <typename KeyType, typename ValueType>
+void SecondStageNode<KeyType, ValueType>::leafInsert(KeyType key, ValueType value) {
+    size_t leafIdx = getLeafIndex(key);
+    m_leaves[leafIdx].insert(key, value);
+
+    if (m_leaves[leafIdx].size() <= m_leafParams.maxLeafSize) {
+        return;
     }
 
-    if (currentMaxAbsoluteError > m_positionErrorThreshold) {
-        m_useTree = true;
-        for (size_t ii = 0; ii < data.size(); ++ii) {
-            m_tree.insert(data[ii]);
-        }
-    } else {
-        m_useTree = false;
+    // Split the leaf in two, keeping equal keys together
+    std::vector<std::pair<KeyType, ValueType>> data;
+    data.reserve(m_leaves[leafIdx].size());
+    m_leaves[leafIdx].collect(data);
+
+    auto splitPoint = std::lower_bound(data.begin(), data.end(), data[data.size() / 2],
+                                       [](const std::pair<KeyType, ValueType> &p1, const std::pair<KeyType, ValueType> &p2) {
+                                           return p1.first < p2.first;
+                                       });
+    if (splitPoint == data.begin()) {
+        return;
     }
 
-    std::cout << "Absolute max error: " << currentMaxAbsoluteError;
-    std::cout << " Max Negative: " << m_maxNegativeError;
-    std::cout << " Max Positive: " << m_maxPositiveError << std::endl;
+    m_leaves[leafIdx].bulkLoad(std::vector<std::pair<KeyType, ValueType>>(data.begin(), splitPoint));
+    GappedArray<KeyType, ValueType> upperLeaf(m_leafParams);
+    upperLeaf.bulkLoad(std::vector<std::pair<KeyType, ValueType>>(splitPoint, data.end()));
+
+    m_leaves.insert(m_leaves.begin() + leafIdx + 1, std::move(upperLeaf));
+    m_leafLowerBounds.insert(m_leafLowerBounds.begin() + leafIdx, splitPoint->first);
+}
+
+template <typename KeyType, typename ValueType>
+template <typename DataAllocator>
+void SecondStageNode<KeyType, ValueType>::releaseLeaves(std::vector<std::pair<KeyType, ValueType>, DataAllocator> &output) {
+    collectLeaves(output);
+    m_leaves.clear();
+    m_leafLowerBounds.clear();
 }
 
 #endif //LEARNED_INDICES_SECONDSTAGE_H
@@ -0,0 +1,476 @@
+/**
+ * @file StaticRecursiveModelIndex.h
+ *
+ * @brief A read only recursive model index specialized at compile time for one fixed configuration
+ *
+ * @date 10/18/2026
+ */
+
+#ifndef LEARNED_INDICES_STATICRECURSIVEMODELINDEX_H
+#define LEARNED_INDICES_STATICRECURSIVEMODELINDEX_H
+
+#include "utils/ModelWeights.h"
+#include <array>
+#include <vector>
+#include <string>
+#include <limits>
+#include <cstddef>
+#include <iostream>
+#include <algorithm>
+#include <boost/optional.hpp>
+
+/**
+ * @brief A second stage model of the form slope * key + intercept, predicting a position directly
+ * (already multiplied by the dataset size, unlike the fractions the networks output)
+ */
+struct StaticLinearModel {
+    double slope = 0;       ///< Positions per unit of key
+    double intercept = 0;   ///< Position of key 0
+
+    template <typename KeyType>
+    double predict(KeyType key) const {
+        return slope * static_cast<double>(key) + intercept;
+    }
+};
+
+/**
+ * @brief A linear model fit by least squares to every (key, position) pair routed to the node
+ */
+struct LinearRegressionModel : StaticLinearModel {
+    /**
+     * @brief Accumulates the fit one pair at a time (Welford style, so large keys don't lose precision)
+     */
+    class Fitter {
+    public:
+        void add(double key, double position) {
+            m_count++;
+            double keyDelta = key - m_meanKey;
+            m_meanKey += keyDelta / m_count;
+            m_meanPosition += (position - m_meanPosition) / m_count;
+            m_variance += keyDelta * (key - m_meanKey);
+            m_covariance += keyDelta * (position - m_meanPosition);
+        }
+
+        LinearRegressionModel fit() const {
+            LinearRegressionModel model;
+            model.slope = m_variance > 0 ? m_covariance / m_variance : 0;
+            model.intercept = m_meanPosition - model.slope * m_meanKey;
+            return model;
+        }
+
+    private:
+        size_t m_count = 0;             ///< Pairs seen
+        double m_meanKey = 0;           ///< Running mean of the keys
+        double m_meanPosition = 0;      ///< Running mean of the positions
+        double m_variance = 0;          ///< Running sum of squared key deviations
+        double m_covariance = 0;        ///< Running sum of key deviation times position deviation
+    };
+};
+
+/**
+ * @brief A linear model through the node's smallest and largest key. Cheaper to fit than a regression,
+ * and exact at both ends of the node
+ */
+struct LinearSplineModel : StaticLinearModel {
+    /**
+     * @brief Remembers the first and last pair. Pairs arrive in key order, so those are the extremes
+     */
+    class Fitter {
+    public:
+        void add(double key, double position) {
+            if (m_count++ == 0) {
+                m_firstKey = key;
+                m_firstPosition = position;
+            }
+            m_lastKey = key;
+            m_lastPosition = position;
+        }
+
+        LinearSplineModel fit() const {
+            LinearSplineModel model;
+            model.slope = m_lastKey > m_firstKey ? (m_lastPosition - m_firstPosition) / (m_lastKey - m_firstKey) : 0;
+            model.intercept = m_firstPosition - model.slope * m_firstKey;
+            return model;
+        }
+
+    private:
+        size_t m_count = 0;             ///< Pairs seen
+        double m_firstKey = 0;          ///< Smallest key
+        double m_firstPosition = 0;     ///< Position of the smallest key
+        double m_lastKey = 0;           ///< Largest key
+        double m_lastPosition = 0;      ///< Position of the largest key
+    };
+};
+
+/**
+ * @brief Search the window with a binary search. Best when error bounds are wide
+ */
+struct BinarySearch {
+    template <typename KeyType>
+    static size_t lowerBound(const KeyType *keys, size_t begin, size_t end, size_t, KeyType key) {
+        return std::lower_bound(keys + begin, keys + end, key) - keys;
+    }
+};
+
+/**
+ * @brief Scan the window from its start. Best when error bounds are a few cache lines at most
+ */
+struct LinearSearch {
+    template <typename KeyType>
+    static size_t lowerBound(const KeyType *keys, size_t begin, size_t end, size_t, KeyType key) {
+        size_t idx = begin;
+        while (idx < end && keys[idx] < key) {
+            ++idx;
+        }
+        return idx;
+    }
+};
+
+/**
+ * @brief Search outward from the prediction in doubling steps. Best when most predictions are much closer
+ * than the node's worst case error
+ */
+struct ExponentialSearch {
+    template <typename KeyType>
+    static size_t lowerBound(const KeyType *keys, size_t begin, size_t end, size_t predicted, KeyType key) {
+        if (begin >= end) {
+            return end;
+        }
+        predicted = std::min(std::max(predicted, begin), end - 1);
+
+        size_t low, high;
+        size_t step = 1;
+        if (keys[predicted] < key) {
+            low = predicted + 1;
+            while (predicted + step < end && keys[predicted + step] < key) {
+                low = predicted + step + 1;
+                step *= 2;
+            }
+            high = std::min(predicted + step, end);
+        } else {
+            high = predicted;
+            while (predicted >= begin + step && !(keys[predicted - step] < key)) {
+                high = predicted - step;
+                step *= 2;
+            }
+            low = predicted >= begin + step ? predicted - step + 1 : begin;
+        }
+        return std::lower_bound(keys + low, keys + high, key) - keys;
+    }
+};
+
+/**
+ * @brief A read only recursive model index with its whole configuration fixed at compile time
+ *
+ * The first stage is the same Dense -> ReLU -> Dense network as in RecursiveModelIndex, but with its weights in
+ * std::arrays sized by numNeurons, so the compiler unrolls it and the whole lookup inlines with no virtual calls
+ * or tensor allocations. Models come from a weight file or explicit weights (see utils/ModelWeights.h), so this
+ * is meant for deploying models trained elsewhere (e.g. notebooks/learned_index_pytorch.ipynb).
+ *
+ * Nodes live inside the object, so allocate indices with a large fan-out on the heap.
+ *
+ * @tparam KeyType [in]: The key type of our index
+ * @tparam ValueType [in]: The value we are storing
+ * @tparam numNeurons [in]: Hidden width of the first stage
+ * @tparam secondStageSize [in]: Number of second stage nodes
+ * @tparam ModelType [in]: Second stage model, LinearRegressionModel or LinearSplineModel
+ * @tparam SearchStrategy [in]: Last mile search, BinarySearch, LinearSearch or ExponentialSearch
+ */
+template <typename KeyType, typename ValueType, size_t numNeurons, size_t secondStageSize,
+          typename ModelType = LinearRegressionModel, typename SearchStrategy = BinarySearch>
+class StaticRecursiveModelIndex {
+    static_assert(numNeurons > 0, "The first stage needs at least one hidden neuron");
+    static_assert(secondStageSize > 0, "The second stage needs at least one node");
+
+public:
+
+    StaticRecursiveModelIndex();
+
+    /**
+     * @brief Build the index on sorted data, fitting the second stage models to the first stage's routing
+     * @param data [in]: (key, value) pairs sorted by key
+     * @param firstStage [in]: First stage parameters, with numNeurons hidden neurons
+     * @return Whether the index was built. On failure the index is unchanged
+     */
+    bool build(const std::vector<std::pair<KeyType, ValueType>> &data, const FirstStageWeights &firstStage);
+
+    /**
+     * @brief Build the index on sorted data with pre-trained second stage models
+     * @param data [in]: (key, value) pairs sorted by key
+     * @param firstStage [in]: First stage parameters, with numNeurons hidden neurons
+     * @param secondStage [in]: Parameters of each of the secondStageSize nodes
+     * @return Whether the index was built. On failure the index is unchanged
+     */
+    bool build(const std::vector<std::pair<KeyType, ValueType>> &data, const FirstStageWeights &firstStage,
+               const std::vector<LinearModelWeights> &secondStage);
+
+    /**
+     * @brief Build the index on sorted data with the models in a weight file
+     * @param path [in]: The weight file
+     * @param data [in]: (key, value) pairs sorted by key
+     * @return Whether the index was built. On failure the index is unchanged
+     */
+    bool load(const std::string &path, const std::vector<std::pair<KeyType, ValueType>> &data);
+
+    /**
+     * @brief Find a specific item in the index
+     * @param key [in]: A key to search for
+     * @return A pair of (key, value) if found.
+     */
+    boost::optional<std::pair<KeyType, ValueType>> find(KeyType key) const {
+        size_t begin, end, predicted;
+        getSearchWindow(key, begin, end, predicted);
+        if (begin >= end || end > m_keys.size()) {
+            return {};
+        }
+
+        size_t idx = SearchStrategy::lowerBound(m_keys.data(), begin, end, predicted, key);
+        if (idx < end && m_keys[idx] == key) {
+            return std::make_pair(key, m_values[idx]);
+        }
+        return {};
+    }
+
+    /**
+     * @brief Predict the positions a key can be at with the models alone, without touching the data
+     * @param key [in]: A key to search for
+     * @param begin [out]: First position the key can be at
+     * @param end [out]: One past the last position the key can be at, begin if it can't be stored
+     * @param predicted [out]: The predicted position, to start searching from
+     */
+    void getSearchWindow(KeyType key, size_t &begin, size_t &end, size_t &predicted) const {
+        const Node &node = m_nodes[getStage(key)];
+        const long prediction = predictPosition(node, key);
+        begin = static_cast<size_t>(std::max(0L, prediction + node.maxNegativeError));
+        end = static_cast<size_t>(std::max(0L, std::min(static_cast<long>(m_numKeys), prediction + node.maxPositiveError + 1)));
+        end = std::max(begin, end);
+        predicted = static_cast<size_t>(prediction);
+    }
+
+    /**
+     * @brief Take another index's models but none of its keys or values, for copies that search data stored
+     * elsewhere (see NumaReplicatedIndex). getSearchWindow then works as on other, find finds nothing
+     * @param other [in]: A built index
+     */
+    void copyModels(const StaticRecursiveModelIndex &other) {
+        m_hiddenWeight = other.m_hiddenWeight;
+        m_hiddenBias = other.m_hiddenBias;
+        m_outputWeight = other.m_outputWeight;
+        m_outputBias = other.m_outputBias;
+        m_nodes = other.m_nodes;
+        m_numKeys = other.m_numKeys;
+        std::vector<KeyType>().swap(m_keys);
+        std::vector<ValueType>().swap(m_values);
+    }
+
+    /**
+     * @return The number of keys indexed
+     */
+    size_t size() const {
+        return m_numKeys;
+    }
+
+    /**
+     * @return The sorted keys
+     */
+    const std::vector<KeyType> &keys() const {
+        return m_keys;
+    }
+
+    /**
+     * @return The values, matching keys() position for position
+     */
+    const std::vector<ValueType> &values() const {
+        return m_values;
+    }
+
+private:
+
+    struct Node {
+        ModelType model;            ///< Predicts the position of a key
+        long maxNegativeError;      ///< Smallest (actual - predicted) of any key in the node
+        long maxPositiveError;      ///< Largest (actual - predicted) of any key in the node
+    };
+
+    /**
+     * @brief Route a key to a second stage node
+     */
+    size_t getStage(KeyType key) const {
+        const float input = static_cast<float>(key);
+        float result = m_outputBias;
+        for (size_t ii = 0; ii < numNeurons; ++ii) {
+            result += m_outputWeight[ii] * std::max(0.0f, m_hiddenWeight[ii] * input + m_hiddenBias[ii]);
+        }
+
+        // The output layer is pre-scaled by secondStageSize, so this is already the node index
+        if (!(result > 0)) {
+            return 0;
+        }
+        return result >= secondStageSize ? secondStageSize - 1 : static_cast<size_t>(result);
+    }
+
+    /**
+     * @brief Predict a key's position with a node's model, clamped to the data
+     */
+    long predictPosition(const Node &node, KeyType key) const {
+        double position = node.model.predict(key);
+        position = std::max(0.0, std::min(position, static_cast<double>(m_numKeys) - 1));
+        return static_cast<long>(position);
+    }
+
+    /**
+     * @brief Check the data is sorted and the first stage has numNeurons neurons
+     * @return Whether both are usable
+     */
+    bool validate(const std::vector<std::pair<KeyType, ValueType>> &data, const FirstStageWeights &firstStage) const;
+
+    /**
+     * @brief Copy in the data and first stage, pre-scaling its output to node indices
+     */
+    void setDataAndFirstStage(const std::vector<std::pair<KeyType, ValueType>> &data, const FirstStageWeights &firstStage);
+
+    /**
+     * @brief Compute exact error bounds of every node in one pass over the keys
+     */
+    void computeErrorBounds();
+
+    std::array<float, numNeurons> m_hiddenWeight;   ///< Weight of each hidden neuron
+    std::array<float, numNeurons> m_hiddenBias;     ///< Bias of each hidden neuron
+    std::array<float, numNeurons> m_outputWeight;   ///< Output weight of each neuron, times secondStageSize
+    float m_outputBias;                             ///< Output bias, times secondStageSize
+    std::array<Node, secondStageSize> m_nodes;      ///< The second stage
+    std::vector<KeyType> m_keys;                    ///< Sorted keys, apart from the values so searches stay dense
+    std::vector<ValueType> m_values;                ///< Values matching m_keys position for position
+    size_t m_numKeys;                               ///< Keys indexed, still known once the data is released
+};
+
+template <typename KeyType, typename ValueType, size_t numNeurons, size_t secondStageSize, typename ModelType, typename SearchStrategy>
+StaticRecursiveModelIndex<KeyType, ValueType, numNeurons, secondStageSize, ModelType, SearchStrategy>::StaticRecursiveModelIndex():
+    m_outputBias(0), m_numKeys(0)
+{
+    m_hiddenWeight.fill(0);
+    m_hiddenBias.fill(0);
+    m_outputWeight.fill(0);
+    // Empty windows until built
+    m_nodes.fill({ModelType(), 0, -1});
+}
+
+template <typename KeyType, typename ValueType, size_t numNeurons, size_t secondStageSize, typename ModelType, typename SearchStrategy>
+bool StaticRecursiveModelIndex<KeyType, ValueType, numNeurons, secondStageSize, ModelType, SearchStrategy>::build(
+        const std::vector<std::pair<KeyType, ValueType>> &data, const FirstStageWeights &firstStage) {
+    if (!validate(data, firstStage)) {
+        return false;
+    }
+    setDataAndFirstStage(data, firstStage);
+
+    std::vector<typename ModelType::Fitter> fitters(secondStageSize);
+    for (size_t ii = 0; ii < m_keys.size(); ++ii) {
+        fitters[getStage(m_keys[ii])].add(static_cast<double>(m_keys[ii]), static_cast<double>(ii));
+    }
+    for (size_t stage = 0; stage < secondStageSize; ++stage) {
+        m_nodes[stage].model = fitters[stage].fit();
+    }
+
+    computeErrorBounds();
+    return true;
+}
+
+template <typename KeyType, typename ValueType, size_t numNeurons, size_t secondStageSize, typename ModelType, typename SearchStrategy>
+bool StaticRecursiveModelIndex<KeyType, ValueType, numNeurons, secondStageSize, ModelType, SearchStrategy>::build(
+        const std::vector<std::pair<KeyType, ValueType>> &data, const FirstStageWeights &firstStage,
+        const std::vector<LinearModelWeights> &secondStage) {
+    if (secondStage.size() != secondStageSize) {
+        std::cerr << "Got " << secondStage.size() << " second stage models, expected " << secondStageSize << std::endl;
+        return false;
+    }
+    if (!validate(data, firstStage)) {
+        return false;
+    }
+    setDataAndFirstStage(data, firstStage);
+
+    // The weights predict position / dataset size, fold the dataset size in
+    const double datasetSize = static_cast<double>(m_keys.size());
+    for (size_t stage = 0; stage < secondStageSize; ++stage) {
+        m_nodes[stage].model.slope = secondStage[stage].weight * datasetSize;
+        m_nodes[stage].model.intercept = secondStage[stage].bias * datasetSize;
+    }
+
+    computeErrorBounds();
+    return true;
+}
+
+template <typename KeyType, typename ValueType, size_t numNeurons, size_t secondStageSize, typename ModelType, typename SearchStrategy>
+bool StaticRecursiveModelIndex<KeyType, ValueType, numNeurons, secondStageSize, ModelType, SearchStrategy>::load(
+        const std::string &path, const std::vector<std::pair<KeyType, ValueType>> &data) {
+    FirstStageWeights firstStage;
+    std::vector<LinearModelWeights> secondStage;
+    if (!loadModelWeights(path, firstStage, secondStage)) {
+        return false;
+    }
+    return build(data, firstStage, secondStage);
+}
+
+template <typename KeyType, typename ValueType, size_t numNeurons, size_t secondStageSize, typename ModelType, typename SearchStrategy>
+bool StaticRecursiveModelIndex<KeyType, ValueType, numNeurons, secondStageSize, ModelType, SearchStrategy>::validate(
+        const std::vector<std::pair<KeyType, ValueType>> &data, const FirstStageWeights &firstStage) const {
+    if (firstStage.numNeurons() != numNeurons || firstStage.hiddenBias.size() != numNeurons ||
+        firstStage.outputWeight.size() != numNeurons) {
+        std::cerr << "First stage has " << firstStage.numNeurons() << " neurons, expected " << numNeurons << std::endl;
+        return false;
+    }
+
+    auto keyLess = [](const std::pair<KeyType, ValueType> &p1, const std::pair<KeyType, ValueType> &p2) {
+        return p1.first < p2.first;
+    };
+    if (!std::is_sorted(data.begin(), data.end(), keyLess)) {
+        std::cerr << "Data must be sorted by key to build a static index" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+template <typename KeyType, typename ValueType, size_t numNeurons, size_t secondStageSize, typename ModelType, typename SearchStrategy>
+void StaticRecursiveModelIndex<KeyType, ValueType, numNeurons, secondStageSize, ModelType, SearchStrategy>::setDataAndFirstStage(
+        const std::vector<std::pair<KeyType, ValueType>> &data, const FirstStageWeights &firstStage) {
+    m_keys.clear();
+    m_values.clear();
+    m_keys.reserve(data.size());
+    m_values.reserve(data.size());
+    for (const auto &pair : data) {
+        m_keys.push_back(pair.first);
+        m_values.push_back(pair.second);
+    }
+    m_numKeys = m_keys.size();
+
+    for (size_t ii = 0; ii < numNeurons; ++ii) {
+        m_hiddenWeight[ii] = firstStage.hiddenWeight[ii];
+        m_hiddenBias[ii] = firstStage.hiddenBias[ii];
+        m_outputWeight[ii] = firstStage.outputWeight[ii] * secondStageSize;
+    }
+    m_outputBias = firstStage.outputBias * secondStageSize;
+}
+
+template <typename KeyType, typename ValueType, size_t numNeurons, size_t secondStageSize, typename ModelType, typename SearchStrategy>
+void StaticRecursiveModelIndex<KeyType, ValueType, numNeurons, secondStageSize, ModelType, SearchStrategy>::computeErrorBounds() {
+    for (auto &node : m_nodes) {
+        node.maxNegativeError = std::numeric_limits<long>::max();
+        node.maxPositiveError = std::numeric_limits<long>::min();
+    }
+
+    for (size_t ii = 0; ii < m_keys.size(); ++ii) {
+        Node &node = m_nodes[getStage(m_keys[ii])];
+        long error = static_cast<long>(ii) - predictPosition(node, m_keys[ii]);
+        node.maxNegativeError = std::min(node.maxNegativeError, error);
+        node.maxPositiveError = std::max(node.maxPositiveError, error);
+    }
+
+    // Nodes nothing routes to get an empty window
+    for (auto &node : m_nodes) {
+        if (node.maxNegativeError > node.maxPositiveError) {
+            node.maxNegativeError = 0;
+            node.maxPositiveError = -1;
+        }
+    }
+}
+
+#endif //LEARNED_INDICES_STATICRECURSIVEMODELINDEX_H
@@ -78,5 +78,30 @@ int main() {
     std::cout << "BTree Timings" << std::endl;
     summaryStats(btreeDurations);
 
+    // Look up every key, with the RMI interleaving lookups to overlap cache misses
+    std::vector<int> batchKeys(values.begin(), values.end());
+    std::vector<boost::optional<std::pair<int, int>>> batchResults;
+
+    auto startTime = std::chrono::system_clock::now();
+    recursiveModelIndex.findBatch(batchKeys, batchResults);
+    auto endTime = std::chrono::system_clock::now();
+    std::chrono::duration<double> rmiBatchDuration = endTime - startTime;
+
+    size_t numFound = std::count_if(batchResults.cbegin(), batchResults.cend(),
+                                    [](const boost::optional<std::pair<int, int>> &result) { return static_cast<bool>(result); });
+
+    startTime = std::chrono::system_clock::now();
+    size_t btreeFound = 0;
+    for (auto key : batchKeys) {
+        btreeFound += btreeMap.find(key) != btreeMap.end();
+    }
+    endTime = std::chrono::system_clock::now();
+    std::chrono::duration<double> btreeBatchDuration = endTime - startTime;
+
+    std::cout << std::endl << std::endl;
+    std::cout << "Batched lookups of " << batchKeys.size() << " keys" << std::endl;
+    std::cout << "RMI (interleaved): " << rmiBatchDuration.count() / batchKeys.size() << " per key, found " << numFound << std::endl;
+    std::cout << "BTree: " << btreeBatchDuration.count() / batchKeys.size() << " per key, found " << btreeFound << std::endl;
+
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,145 @@
+/**
+ * @file Arena.h
+ *
+ * @brief A bump allocator for transient training buffers
+ *
+ * @date 10/18/2026
+ */
+
+#ifndef LEARNED_INDICES_ARENA_H
+#define LEARNED_INDICES_ARENA_H
+
+#include "HugePageAllocator.h"
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+
+/**
+ * @brief Hands out memory from huge page chunks by bumping a pointer, and frees all of it at once.
+ * Individual frees are no-ops, so this is only for buffers that all die together (e.g. at the end of train())
+ */
+class Arena {
+public:
+
+    /**
+     * @brief Create an empty arena
+     * @param initialChunkSize [in]: Size of the first chunk, later chunks double in size
+     */
+    explicit Arena(size_t initialChunkSize = HUGE_PAGE_SIZE):
+        m_current(nullptr), m_remaining(0), m_initialChunkSize(initialChunkSize),
+        m_nextChunkSize(initialChunkSize), m_bytesAllocated(0) {}
+
+    ~Arena() {
+        release();
+    }
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    /**
+     * @brief Allocate memory that lives until release()
+     * @param bytes [in]: Number of bytes
+     * @param alignment [in]: Required alignment, a power of two
+     * @return The memory
+     */
+    void *allocate(size_t bytes, size_t alignment) {
+        uintptr_t current = reinterpret_cast<uintptr_t>(m_current);
+        size_t padding = (alignment - current % alignment) % alignment;
+
+        if (m_current == nullptr || padding + bytes > m_remaining) {
+            size_t chunkSize = roundUpToHugePage(std::max(m_nextChunkSize, bytes + alignment));
+            char *chunk = static_cast<char *>(mapHugePages(chunkSize));
+            if (chunk == nullptr) {
+                throw std::bad_alloc();
+            }
+            m_chunks.push_back({chunk, chunkSize});
+            m_current = chunk;
+            m_remaining = chunkSize;
+            m_nextChunkSize *= 2;
+            padding = 0;
+        }
+
+        void *ptr = m_current + padding;
+        m_current += padding + bytes;
+        m_remaining -= padding + bytes;
+        m_bytesAllocated += bytes;
+        return ptr;
+    }
+
+    /**
+     * @brief Free everything allocated from the arena
+     */
+    void release() {
+        for (const auto &chunk : m_chunks) {
+            unmapHugePages(chunk.data, chunk.size);
+        }
+        m_chunks.clear();
+        m_current = nullptr;
+        m_remaining = 0;
+        m_nextChunkSize = m_initialChunkSize;
+        m_bytesAllocated = 0;
+    }
+
+    /**
+     * @return Bytes handed out since the last release()
+     */
+    size_t bytesAllocated() const {
+        return m_bytesAllocated;
+    }
+
+private:
+    struct Chunk {
+        char *data;     ///< Start of the chunk
+        size_t size;    ///< Size of the chunk in bytes
+    };
+
+    std::vector<Chunk> m_chunks;    ///< Every chunk we mapped
+    char *m_current;                ///< Next free byte in the current chunk
+    size_t m_remaining;             ///< Free bytes left in the current chunk
+    size_t m_initialChunkSize;      ///< Size of the first chunk
+    size_t m_nextChunkSize;         ///< Size of the next chunk we map
+    size_t m_bytesAllocated;        ///< Bytes handed out since the last release
+};
+
+/**
+ * @brief A standard allocator drawing from an Arena, so containers can use it
+ * @tparam T [in]: The type to allocate
+ */
+template <typename T>
+class ArenaAllocator {
+public:
+    typedef T value_type;
+
+    explicit ArenaAllocator(Arena *arena): m_arena(arena) {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other): m_arena(other.getArena()) {}
+
+    T *allocate(size_t n) {
+        return static_cast<T *>(m_arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *, size_t) {
+        // Freed all at once by Arena::release
+    }
+
+    Arena *getArena() const {
+        return m_arena;
+    }
+
+private:
+    Arena *m_arena;     ///< The arena we draw from
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T> &lhs, const ArenaAllocator<U> &rhs) {
+    return lhs.getArena() == rhs.getArena();
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T> &lhs, const ArenaAllocator<U> &rhs) {
+    return !(lhs == rhs);
+}
+
+#endif //LEARNED_INDICES_ARENA_H
@@ -0,0 +1,164 @@
+/**
+ * @file BloomFilter.h
+ *
+ * @breif A simple Bloom filter used as the existence stage of the Recursive Model Index
+ *
+ * @date 10/18/2026
+ * @author Ben Caine
+ */
+
+#ifndef LEARNED_INDICES_BLOOMFILTER_H
+#define LEARNED_INDICES_BLOOMFILTER_H
+
+#include <vector>
+#include <cmath>
+#include <iostream>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <functional>
+
+/**
+ * @brief A container for the parameters of an existence filter
+ */
+struct ExistenceFilterParameters {
+    float falsePositiveRate = 0.01;  ///< The false positive rate we size the filter for, strictly between 0 and 1
+    size_t maxMemoryBytes = 0;       ///< Upper bound on the filter size in bytes (0 for no limit)
+};
+
+/**
+ * @brief A Bloom filter over keys using double hashing
+ *
+ * Never returns a false negative. The false positive rate holds for the number of keys the
+ * filter was sized for, and degrades as more keys are inserted past that.
+ *
+ * @tparam KeyType [in]: The key type we are filtering
+ */
+template <typename KeyType>
+class BloomFilter {
+public:
+
+    /**
+     * @brief Create an empty filter that lets every key through
+     */
+    BloomFilter(): m_numHashes(0) {}
+
+    /**
+     * @brief Create a filter sized for a number of keys. A false positive rate outside (0, 1) is rejected,
+     * leaving a filter that lets every key through
+     * @param expectedNumKeys [in]: The number of keys we expect to insert
+     * @param params [in]: The desired false positive rate and memory budget
+     */
+    BloomFilter(size_t expectedNumKeys, const ExistenceFilterParameters &params);
+
+    /**
+     * @brief Add a key to the filter
+     * @param key [in]: The key to add
+     */
+    void insert(KeyType key);
+
+    /**
+     * @brief Check if a key may be in the filter
+     * @param key [in]: The key to check
+     * @return False if the key is definitely not present, true if it might be
+     */
+    bool mayContain(KeyType key) const;
+
+    /**
+     * @return The number of bits in the filter
+     */
+    size_t numBits() const {
+        return m_bits.size() * 64;
+    }
+
+    /**
+     * @return The number of hash functions used per key
+     */
+    int numHashes() const {
+        return m_numHashes;
+    }
+
+private:
+
+    /**
+     * @brief Hash a key to 64 bits (splitmix64 finalizer over std::hash)
+     */
+    static uint64_t hashKey(KeyType key) {
+        uint64_t x = static_cast<uint64_t>(std::hash<KeyType>()(key));
+        x += 0x9E3779B97F4A7C15ULL;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+        return x ^ (x >> 31);
+    }
+
+    std::vector<uint64_t> m_bits;   ///< The bit array, packed in 64 bit words
+    int m_numHashes;                ///< Number of hash functions (0 means the filter is disabled)
+};
+
+template <typename KeyType>
+BloomFilter<KeyType>::BloomFilter(size_t expectedNumKeys, const ExistenceFilterParameters &params): m_numHashes(0) {
+    // 0 would ask for infinitely many bits, 1 or more for none at all
+    if (!(params.falsePositiveRate > 0 && params.falsePositiveRate < 1)) {
+        std::cerr << "Existence filter false positive rate must be in (0, 1), got " << params.falsePositiveRate
+                  << ". Filter disabled" << std::endl;
+        return;
+    }
+
+    const double ln2 = std::log(2.0);
+    size_t numKeys = std::max(expectedNumKeys, static_cast<size_t>(1));
+
+    // Optimal number of bits for the requested false positive rate
+    double desiredBits = -static_cast<double>(numKeys) * std::log(params.falsePositiveRate) / (ln2 * ln2);
+    size_t numBits = static_cast<size_t>(std::ceil(desiredBits));
+
+    // Cap to the memory budget. This raises the false positive rate, but never causes false negatives
+    if (params.maxMemoryBytes > 0) {
+        numBits = std::min(numBits, params.maxMemoryBytes * 8);
+    }
+
+    size_t numWords = std::max(static_cast<size_t>(1), (numBits + 63) / 64);
+    m_bits.assign(numWords, 0);
+
+    // Optimal number of hashes for the bits we actually got
+    double bitsPerKey = static_cast<double>(numWords * 64) / numKeys;
+    m_numHashes = std::max(1, static_cast<int>(std::round(bitsPerKey * ln2)));
+}
+
+template <typename KeyType>
+void BloomFilter<KeyType>::insert(KeyType key) {
+    if (m_numHashes == 0) {
+        return;
+    }
+
+    uint64_t hash = hashKey(key);
+    uint64_t h1 = hash;
+    uint64_t h2 = (hash >> 32) | 1;
+    size_t numBits = m_bits.size() * 64;
+
+    for (int ii = 0; ii < m_numHashes; ++ii) {
+        size_t bit = (h1 + ii * h2) % numBits;
+        m_bits[bit / 64] |= (1ULL << (bit % 64));
+    }
+}
+
+template <typename KeyType>
+bool BloomFilter<KeyType>::mayContain(KeyType key) const {
+    if (m_numHashes == 0) {
+        return true;
+    }
+
+    uint64_t hash = hashKey(key);
+    uint64_t h1 = hash;
+    uint64_t h2 = (hash >> 32) | 1;
+    size_t numBits = m_bits.size() * 64;
+
+    for (int ii = 0; ii < m_numHashes; ++ii) {
+        size_t bit = (h1 + ii * h2) % numBits;
+        if (!(m_bits[bit / 64] & (1ULL << (bit % 64)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#endif //LEARNED_INDICES_BLOOMFILTER_H
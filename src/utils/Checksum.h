@@ -0,0 +1,44 @@
+/**
+ * @file Checksum.h
+ *
+ * @brief CRC-32 for detecting torn or corrupt records in files we persist
+ *
+ * @date 10/18/2026
+ */
+
+#ifndef LEARNED_INDICES_CHECKSUM_H
+#define LEARNED_INDICES_CHECKSUM_H
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief CRC-32 (the zlib polynomial) of a buffer
+ * @param data [in]: The bytes to checksum
+ * @param size [in]: Number of bytes
+ * @param crc [in]: The CRC of the preceding bytes, to checksum a stream in pieces
+ * @return The CRC of everything so far
+ */
+inline uint32_t crc32(const void *data, size_t size, uint32_t crc = 0) {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> entries;
+        for (uint32_t ii = 0; ii < 256; ++ii) {
+            uint32_t entry = ii;
+            for (int bit = 0; bit < 8; ++bit) {
+                entry = (entry & 1) ? 0xEDB88320u ^ (entry >> 1) : entry >> 1;
+            }
+            entries[ii] = entry;
+        }
+        return entries;
+    }();
+
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    crc = ~crc;
+    for (size_t ii = 0; ii < size; ++ii) {
+        crc = table[(crc ^ bytes[ii]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+#endif //LEARNED_INDICES_CHECKSUM_H
@@ -10,32 +10,83 @@
 #ifndef LEARNED_INDICES_DATAUTILS_H
 #define LEARNED_INDICES_DATAUTILS_H
 
-#include <unordered_set>
+#include <vector>
 #include <random>
-#include <chrono>
+#include <numeric>
+#include <algorithm>
 #include <cassert>
 
 /**
- * @brief Get a random batch to train on
- * @tparam KeyType [in]: The key type of our data
- * @param batchSize [in]: How many elements we want
- * @param datasetSize [in]: The total dataset size
- * @return A set of indices in the data that we want to use in this batch
+ * @brief Draws batches of training indices from a dataset, reusing one generator and one index buffer
+ *
+ * By default each batch is stratified: the dataset is split into batchSize equal strata and one index is
+ * drawn uniformly from each, so a batch covers the whole CDF with no duplicates and costs O(batchSize).
+ * With full pass epochs enabled, indices come from a shuffled permutation of the dataset instead, and
+ * every index is visited once per pass (a trailing partial batch is dropped, and the next pass reshuffles).
  */
-template <typename KeyType>
-std::unordered_set<KeyType> getRandomBatch(int batchSize, int datasetSize) {
-    assert(datasetSize >= batchSize && "Dataset size is smaller than requested batch size, which causes an infinite loop");
-
-    std::unordered_set<KeyType> randomKeys;
-    auto seed = std::chrono::high_resolution_clock::now().time_since_epoch().count();
-    std::mt19937 rng(seed);
-    std::uniform_int_distribution<KeyType> distribution(0, datasetSize);
-
-    while (randomKeys.size() < batchSize) {
-        auto val = distribution(rng);
-        randomKeys.insert(val);
+class BatchSampler {
+public:
+
+    /**
+     * @brief Create a sampler
+     * @param batchSize [in]: How many indices per batch
+     * @param datasetSize [in]: The total dataset size
+     * @param seed [in]: Seed of the generator, so training is reproducible
+     * @param fullPassEpochs [in]: Whether to walk a shuffled permutation instead of stratified sampling
+     */
+    BatchSampler(size_t batchSize, size_t datasetSize, unsigned int seed, bool fullPassEpochs = false):
+        m_batchSize(batchSize), m_datasetSize(datasetSize), m_fullPassEpochs(fullPassEpochs),
+        m_rng(seed), m_batch(batchSize), m_passPosition(0)
+    {
+        assert(datasetSize >= batchSize && "Dataset size is smaller than requested batch size");
+
+        if (m_fullPassEpochs) {
+            m_permutation.resize(m_datasetSize);
+            std::iota(m_permutation.begin(), m_permutation.end(), 0);
+            std::shuffle(m_permutation.begin(), m_permutation.end(), m_rng);
+        }
+    }
+
+    /**
+     * @return The number of batches making up one epoch (1 unless we are doing full passes)
+     */
+    size_t batchesPerEpoch() const {
+        return m_fullPassEpochs ? m_datasetSize / m_batchSize : 1;
+    }
+
+    /**
+     * @brief Draw the next batch
+     * @return A reference to batchSize indices into the data. Only valid until the next call
+     */
+    const std::vector<size_t> &nextBatch() {
+        if (m_fullPassEpochs) {
+            if (m_passPosition + m_batchSize > m_datasetSize) {
+                std::shuffle(m_permutation.begin(), m_permutation.end(), m_rng);
+                m_passPosition = 0;
+            }
+            std::copy(m_permutation.begin() + m_passPosition,
+                      m_permutation.begin() + m_passPosition + m_batchSize, m_batch.begin());
+            m_passPosition += m_batchSize;
+        } else {
+            // Stratum ii covers [ii * n / b, (ii + 1) * n / b)
+            for (size_t ii = 0; ii < m_batchSize; ++ii) {
+                size_t start = ii * m_datasetSize / m_batchSize;
+                size_t end = (ii + 1) * m_datasetSize / m_batchSize;
+                std::uniform_int_distribution<size_t> distribution(start, end - 1);
+                m_batch[ii] = distribution(m_rng);
+            }
+        }
+        return m_batch;
     }
-    return randomKeys;
-}
+
+private:
+    size_t m_batchSize;                 ///< Number of indices per batch
+    size_t m_datasetSize;               ///< Number of items we are sampling from
+    bool m_fullPassEpochs;              ///< Whether we walk a permutation instead of stratified sampling
+    std::mt19937 m_rng;                 ///< The one generator used for all batches
+    std::vector<size_t> m_batch;        ///< Reused buffer holding the current batch
+    std::vector<size_t> m_permutation;  ///< Shuffled indices for full pass epochs
+    size_t m_passPosition;              ///< Where we are in the current pass over m_permutation
+};
 
 #endif //LEARNED_INDICES_DATAUTILS_H
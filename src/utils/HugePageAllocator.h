@@ -0,0 +1,131 @@
+/**
+ * @file HugePageAllocator.h
+ *
+ * @brief Huge page backed allocation for large index storage
+ *
+ * @date 10/18/2026
+ */
+
+#ifndef LEARNED_INDICES_HUGEPAGEALLOCATOR_H
+#define LEARNED_INDICES_HUGEPAGEALLOCATOR_H
+
+#include <new>
+#include <cstddef>
+#include <cstdint>
+#include <sys/mman.h>
+
+/// Size of a (2 MB, x86-64) huge page
+const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+/**
+ * @brief Round a size up to a whole number of huge pages
+ */
+inline size_t roundUpToHugePage(size_t bytes) {
+    return (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+}
+
+/**
+ * @brief Map memory backed by huge pages
+ *
+ * Tries explicit huge pages (MAP_HUGETLB) first, which only works if pages were reserved in
+ * /proc/sys/vm/nr_hugepages. Otherwise maps normal pages aligned to a huge page boundary and asks for
+ * transparent huge pages, which the kernel honours if THP is set to "always" or "madvise".
+ *
+ * @param bytes [in]: Size in bytes, rounded up to a whole number of huge pages
+ * @return The mapping, or nullptr if mmap failed
+ */
+inline void *mapHugePages(size_t bytes) {
+    const size_t size = roundUpToHugePage(bytes);
+
+#ifdef MAP_HUGETLB
+    void *hugePages = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (hugePages != MAP_FAILED) {
+        return hugePages;
+    }
+#endif
+
+    // Over-map by a page so we can trim the mapping to a huge page aligned range
+    const size_t paddedSize = size + HUGE_PAGE_SIZE;
+    void *mapping = mmap(nullptr, paddedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        return nullptr;
+    }
+
+    char *raw = static_cast<char *>(mapping);
+    char *aligned = reinterpret_cast<char *>((reinterpret_cast<uintptr_t>(raw) + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE);
+    if (aligned > raw) {
+        munmap(raw, aligned - raw);
+    }
+    const size_t tailSize = (raw + paddedSize) - (aligned + size);
+    if (tailSize > 0) {
+        munmap(aligned + size, tailSize);
+    }
+
+#ifdef MADV_HUGEPAGE
+    madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+    return aligned;
+}
+
+/**
+ * @brief Unmap memory from mapHugePages
+ * @param ptr [in]: The mapping
+ * @param bytes [in]: The size passed to mapHugePages
+ */
+inline void unmapHugePages(void *ptr, size_t bytes) {
+    munmap(ptr, roundUpToHugePage(bytes));
+}
+
+/**
+ * @brief A standard allocator that puts large allocations (the sorted data, the overflow array)
+ * on huge pages, cutting TLB misses on lookups. Allocations under half a huge page would mostly
+ * waste the page, so they come from the regular heap.
+ * @tparam T [in]: The type to allocate
+ */
+template <typename T>
+class HugePageAllocator {
+public:
+    typedef T value_type;
+
+    /// Smallest allocation we put on huge pages
+    static const size_t MIN_HUGE_PAGE_ALLOCATION = HUGE_PAGE_SIZE / 2;
+
+    HugePageAllocator() = default;
+
+    template <typename U>
+    HugePageAllocator(const HugePageAllocator<U> &) {}
+
+    T *allocate(size_t n) {
+        const size_t bytes = n * sizeof(T);
+        if (bytes < MIN_HUGE_PAGE_ALLOCATION) {
+            return static_cast<T *>(::operator new(bytes));
+        }
+
+        void *ptr = mapHugePages(bytes);
+        if (ptr == nullptr) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T *>(ptr);
+    }
+
+    void deallocate(T *ptr, size_t n) {
+        const size_t bytes = n * sizeof(T);
+        if (bytes < MIN_HUGE_PAGE_ALLOCATION) {
+            ::operator delete(ptr);
+        } else {
+            unmapHugePages(ptr, bytes);
+        }
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const HugePageAllocator<T> &, const HugePageAllocator<U> &) {
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const HugePageAllocator<T> &, const HugePageAllocator<U> &) {
+    return false;
+}
+
+#endif //LEARNED_INDICES_HUGEPAGEALLOCATOR_H
@@ -0,0 +1,218 @@
+/**
+ * @file ModelWeights.h
+ *
+ * @brief Plain model parameters, and the file format used to exchange them with the PyTorch notebook
+ *
+ * The weight file is whitespace separated text, so it is easy to write from Python and to diff:
+ *
+ *     learned_indices_weights 1
+ *     first_stage <numNeurons>
+ *     hidden_weight <numNeurons floats>
+ *     hidden_bias <numNeurons floats>
+ *     output_weight <numNeurons floats>
+ *     output_bias <1 float>
+ *     second_stage <numNodes>
+ *     <weight> <bias>        (one line per node, numNodes lines)
+ *
+ * The first stage is Dense(1, numNeurons) -> ReLU -> Dense(numNeurons, 1), and every second stage node is
+ * Dense(1, 1). As in training, every model maps a key to its position divided by the dataset size, so a file
+ * stays valid as the dataset grows. Floats should be written with 9 significant digits to round trip exactly.
+ *
+ * @date 10/18/2026
+ */
+
+#ifndef LEARNED_INDICES_MODELWEIGHTS_H
+#define LEARNED_INDICES_MODELWEIGHTS_H
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+/// Version of the weight file format written by saveModelWeights and accepted by loadModelWeights
+const int MODEL_WEIGHTS_FORMAT_VERSION = 1;
+
+/**
+ * @brief The parameters of the first stage network (Dense -> ReLU -> Dense)
+ */
+struct FirstStageWeights {
+    std::vector<float> hiddenWeight;    ///< Weight of each hidden neuron
+    std::vector<float> hiddenBias;      ///< Bias of each hidden neuron
+    std::vector<float> outputWeight;    ///< Weight of each hidden neuron in the output
+    float outputBias = 0;               ///< Bias of the output
+
+    /**
+     * @return The number of hidden neurons
+     */
+    size_t numNeurons() const {
+        return hiddenWeight.size();
+    }
+
+    /**
+     * @brief Evaluate the network
+     * @param key [in]: The key, as a float
+     * @return The predicted position divided by the dataset size
+     */
+    float predict(float key) const {
+        float result = outputBias;
+        for (size_t ii = 0; ii < hiddenWeight.size(); ++ii) {
+            result += outputWeight[ii] * std::max(0.0f, hiddenWeight[ii] * key + hiddenBias[ii]);
+        }
+        return result;
+    }
+};
+
+/**
+ * @brief The parameters of a second stage linear model
+ */
+struct LinearModelWeights {
+    float weight = 0;   ///< Slope of the model
+    float bias = 0;     ///< Intercept of the model
+
+    /**
+     * @brief Evaluate the model
+     * @param key [in]: The key, as a float
+     * @return The predicted position divided by the dataset size
+     */
+    float predict(float key) const {
+        return weight * key + bias;
+    }
+};
+
+/**
+ * @brief Read a weight file
+ * @param path [in]: The file to read
+ * @param firstStage [out]: The first stage parameters
+ * @param secondStage [out]: The parameters of every second stage node
+ * @return Whether the file was read successfully. On failure firstStage and secondStage are unchanged
+ */
+inline bool loadModelWeights(const std::string &path, FirstStageWeights &firstStage,
+                             std::vector<LinearModelWeights> &secondStage) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Could not open weight file: " << path << std::endl;
+        return false;
+    }
+
+    // Every value takes at least a digit and a separator, which bounds the layer sizes a file can really hold
+    file.seekg(0, std::ios::end);
+    const std::streamoff fileSize = file.tellg();
+    file.seekg(0, std::ios::beg);
+    auto maxValuesLeft = [&]() {
+        return static_cast<size_t>(std::max<std::streamoff>(0, fileSize - file.tellg())) / 2;
+    };
+
+    std::string tag;
+    int version = 0;
+    file >> tag >> version;
+    if (tag != "learned_indices_weights" || version != MODEL_WEIGHTS_FORMAT_VERSION) {
+        std::cerr << "Unsupported weight file: " << path << " (expected learned_indices_weights "
+                  << MODEL_WEIGHTS_FORMAT_VERSION << ")" << std::endl;
+        return false;
+    }
+
+    auto readTagged = [&](const std::string &expectedTag, std::vector<float> &values) {
+        file >> tag;
+        for (auto &value : values) {
+            file >> value;
+        }
+        return tag == expectedTag && static_cast<bool>(file);
+    };
+
+    size_t numNeurons = 0;
+    file >> tag >> numNeurons;
+    if (tag != "first_stage" || !file) {
+        std::cerr << "Malformed first stage in weight file: " << path << std::endl;
+        return false;
+    }
+    if (numNeurons > maxValuesLeft() / 3) {
+        std::cerr << "First stage of " << numNeurons << " neurons is larger than weight file: " << path << std::endl;
+        return false;
+    }
+
+    // Parse into copies, so a bad file leaves the caller's weights alone
+    FirstStageWeights newFirstStage;
+    newFirstStage.hiddenWeight.assign(numNeurons, 0);
+    newFirstStage.hiddenBias.assign(numNeurons, 0);
+    newFirstStage.outputWeight.assign(numNeurons, 0);
+    std::vector<float> outputBias(1);
+    if (!readTagged("hidden_weight", newFirstStage.hiddenWeight) || !readTagged("hidden_bias", newFirstStage.hiddenBias) ||
+        !readTagged("output_weight", newFirstStage.outputWeight) || !readTagged("output_bias", outputBias)) {
+        std::cerr << "Malformed first stage in weight file: " << path << std::endl;
+        return false;
+    }
+    newFirstStage.outputBias = outputBias[0];
+
+    size_t numNodes = 0;
+    file >> tag >> numNodes;
+    if (tag != "second_stage" || !file) {
+        std::cerr << "Malformed second stage in weight file: " << path << std::endl;
+        return false;
+    }
+    if (numNodes > maxValuesLeft() / 2) {
+        std::cerr << "Second stage of " << numNodes << " nodes is larger than weight file: " << path << std::endl;
+        return false;
+    }
+
+    std::vector<LinearModelWeights> newSecondStage(numNodes);
+    for (auto &node : newSecondStage) {
+        file >> node.weight >> node.bias;
+    }
+    if (!file) {
+        std::cerr << "Malformed second stage in weight file: " << path << std::endl;
+        return false;
+    }
+
+    // Anything left over means the layer sizes in the file don't match its contents
+    file >> std::ws;
+    if (file.peek() != std::ifstream::traits_type::eof()) {
+        std::cerr << "Unexpected data after the second stage in weight file: " << path << std::endl;
+        return false;
+    }
+
+    firstStage = newFirstStage;
+    secondStage = newSecondStage;
+    return true;
+}
+
+/**
+ * @brief Write a weight file
+ * @param path [in]: The file to write
+ * @param firstStage [in]: The first stage parameters
+ * @param secondStage [in]: The parameters of every second stage node
+ * @return Whether the file was written successfully
+ */
+inline bool saveModelWeights(const std::string &path, const FirstStageWeights &firstStage,
+                             const std::vector<LinearModelWeights> &secondStage) {
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "Could not open weight file: " << path << std::endl;
+        return false;
+    }
+
+    file << std::setprecision(9);
+    file << "learned_indices_weights " << MODEL_WEIGHTS_FORMAT_VERSION << "\n";
+    file << "first_stage " << firstStage.numNeurons() << "\n";
+
+    auto writeTagged = [&](const std::string &tag, const std::vector<float> &values) {
+        file << tag;
+        for (auto value : values) {
+            file << " " << value;
+        }
+        file << "\n";
+    };
+    writeTagged("hidden_weight", firstStage.hiddenWeight);
+    writeTagged("hidden_bias", firstStage.hiddenBias);
+    writeTagged("output_weight", firstStage.outputWeight);
+    writeTagged("output_bias", {firstStage.outputBias});
+
+    file << "second_stage " << secondStage.size() << "\n";
+    for (const auto &node : secondStage) {
+        file << node.weight << " " << node.bias << "\n";
+    }
+    return static_cast<bool>(file);
+}
+
+#endif //LEARNED_INDICES_MODELWEIGHTS_H
@@ -9,14 +9,40 @@
 #ifndef LEARNED_INDICES_NETWORKPARAMETERS_H
 #define LEARNED_INDICES_NETWORKPARAMETERS_H
 
+#include <cstddef>
+
 /**
  * @brief A container for the hyperparameters of our first level network
  */
 struct NetworkParameters {
-    int batchSize;      ///< The batch size of our network
-    int maxNumEpochs;   ///< The max number of epochs to train the network for
-    float learningRate; ///< The learning rate of our Adam solver
-    int numNeurons;     ///< The number of neurons
+    int batchSize;                  ///< The batch size of our network
+    int maxNumEpochs;               ///< The max number of epochs to train the network for
+    float learningRate;             ///< The learning rate of our Adam solver
+    int numNeurons;                 ///< The number of neurons
+    unsigned int seed = 0;          ///< Seed for sampling training batches
+    bool fullPassEpochs = false;    ///< Whether an epoch is a full shuffled pass over the data instead of one batch
+};
+
+/**
+ * @brief A container for the parameters of a sampled (bounded time) index build
+ */
+struct SampledBuildParameters {
+    float sampleFraction = 0.001;   ///< Fraction of the sorted keys (evenly spaced quantiles) to fit models on
+    size_t minSampleSize = 10000;   ///< Never fit on fewer keys than this (or the whole dataset, if smaller)
+};
+
+/**
+ * @brief A container for the parameters of multithreaded first stage training
+ */
+struct ParallelTrainingParameters {
+    unsigned int numThreads = 0;    ///< Training threads, 0 for one per hardware thread
+    bool hogwild = false;           ///< Lock free asynchronous updates instead of synchronously averaged gradients
+    int batchesPerStep = 4;         ///< Batches each thread averages between synchronous steps, amortizing the barriers
+    int convergenceWindow = 100;    ///< Iterations whose mean loss is compared in each convergence check
+    float minImprovement = 0.001;   ///< Relative drop in window loss below which a window counts as a plateau
+    int patience = 5;               ///< Plateaued windows in a row before decaying the learning rate or stopping
+    int maxNumDecays = 3;           ///< Times a plateau cuts the learning rate before the next one stops training
+    float learningRateDecay = 0.1;  ///< Factor a plateau multiplies the learning rate by
 };
 
 #endif //LEARNED_INDICES_NETWORKPARAMETERS_H
@@ -0,0 +1,425 @@
+/**
+ * @file Numa.h
+ *
+ * @brief NUMA topology, memory placement and thread pinning, with or without libnuma
+ *
+ * Built with LEARNED_INDICES_USE_LIBNUMA, topology and placement go through libnuma. Otherwise the topology is
+ * read from /sys/devices/system/node and memory is placed with the mbind system call directly, so nothing
+ * extra needs to be installed. Either way placement is best effort: if the kernel refuses a policy (no NUMA
+ * support, or a container that filters mbind) memory stays wherever it is first touched.
+ *
+ * A topology can also be emulated, splitting the CPUs of a smaller machine into more nodes. Emulated nodes
+ * map their memory onto the real nodes round robin, so code paths and thread placement can be exercised on a
+ * single node machine, although every node is then equally close.
+ *
+ * @date 10/19/2026
+ */
+
+#ifndef LEARNED_INDICES_NUMA_H
+#define LEARNED_INDICES_NUMA_H
+
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#ifdef LEARNED_INDICES_USE_LIBNUMA
+#include <numa.h>
+#endif
+
+#ifndef MPOL_BIND
+#define MPOL_BIND 2
+#endif
+#ifndef MPOL_INTERLEAVE
+#define MPOL_INTERLEAVE 3
+#endif
+
+/**
+ * @brief Where the sorted data of a NUMA replicated index lives
+ */
+enum class NumaDataPlacement {
+    Replicate,      ///< A full copy on every node. Every access is local, at numNodes times the memory
+    Interleave,     ///< One copy with pages spread round robin over the nodes, so bandwidth is shared evenly
+    Partition       ///< One copy split into contiguous key ranges, one per node. Local if keys go to their owner
+};
+
+/**
+ * @brief A container for the parameters of NUMA aware deployment
+ */
+struct NumaParameters {
+    size_t numNodes = 0;                                            ///< Nodes to use, 0 for all of them. More than the machine has are emulated
+    NumaDataPlacement dataPlacement = NumaDataPlacement::Replicate; ///< Where the sorted data lives
+};
+
+/**
+ * @brief The NUMA nodes of the machine (or an emulation of more), and the CPUs of each
+ */
+class NumaTopology {
+public:
+
+    /**
+     * @brief Read the machine's topology, restricted to the CPUs this process may run on
+     * @return The topology, a single node with every allowed CPU if the machine reports none
+     */
+    static NumaTopology detect();
+
+    /**
+     * @brief Use numNodes nodes: the real ones if the machine has that many, otherwise an emulation that
+     * splits the allowed CPUs into numNodes groups and maps their memory onto the real nodes round robin
+     * @param numNodes [in]: Number of nodes, 0 for the machine's own
+     */
+    static NumaTopology withNodes(size_t numNodes);
+
+    /**
+     * @return The number of nodes
+     */
+    size_t numNodes() const {
+        return m_nodeCpus.size();
+    }
+
+    /**
+     * @return The CPUs of a node
+     */
+    const std::vector<int> &cpus(size_t node) const {
+        return m_nodeCpus[node];
+    }
+
+    /**
+     * @return The real node holding a node's memory (itself, unless emulated)
+     */
+    int memoryNode(size_t node) const {
+        return m_memoryNodes[node];
+    }
+
+    /**
+     * @return Whether some nodes are emulated
+     */
+    bool isEmulated() const {
+        return m_emulated;
+    }
+
+private:
+    NumaTopology(): m_emulated(false) {}
+
+    /**
+     * @brief Parse a kernel CPU or node list such as "0-3,8-11"
+     */
+    static std::vector<int> parseList(const std::string &list);
+
+    std::vector<std::vector<int>> m_nodeCpus;   ///< CPUs of each node
+    std::vector<int> m_memoryNodes;             ///< Real node backing each node's memory
+    bool m_emulated;                            ///< Whether nodes were split out of a smaller machine
+};
+
+/**
+ * @brief Page aligned anonymous memory whose pages can be placed on NUMA nodes before they are first touched
+ */
+class NumaBuffer {
+public:
+    NumaBuffer(): m_data(nullptr), m_size(0) {}
+
+    /**
+     * @brief Map a buffer. Its pages are only allocated when first touched, according to their policy then
+     * @param bytes [in]: Size in bytes
+     */
+    explicit NumaBuffer(size_t bytes);
+
+    ~NumaBuffer() {
+        if (m_data != nullptr) {
+            munmap(m_data, m_size);
+        }
+    }
+
+    NumaBuffer(NumaBuffer &&other): m_data(other.m_data), m_size(other.m_size) {
+        other.m_data = nullptr;
+        other.m_size = 0;
+    }
+
+    NumaBuffer &operator=(NumaBuffer &&other) {
+        std::swap(m_data, other.m_data);
+        std::swap(m_size, other.m_size);
+        return *this;
+    }
+
+    NumaBuffer(const NumaBuffer &) = delete;
+    NumaBuffer &operator=(const NumaBuffer &) = delete;
+
+    /**
+     * @brief Put a range of the buffer on one node
+     * @param topology [in]: The topology node refers to
+     * @param node [in]: The node
+     * @param offset [in]: Start of the range in bytes, rounded down to a page
+     * @param length [in]: Length of the range in bytes, rounded up to a page
+     * @return Whether the kernel accepted the policy
+     */
+    bool bindToNode(const NumaTopology &topology, size_t node, size_t offset, size_t length);
+
+    /**
+     * @brief Put the whole buffer on one node
+     */
+    bool bindToNode(const NumaTopology &topology, size_t node) {
+        return bindToNode(topology, node, 0, m_size);
+    }
+
+    /**
+     * @brief Spread the buffer's pages round robin over every node
+     * @param topology [in]: The nodes to spread over
+     * @return Whether the kernel accepted the policy
+     */
+    bool interleave(const NumaTopology &topology);
+
+    /**
+     * @return The start of the buffer
+     */
+    void *data() const {
+        return m_data;
+    }
+
+    /**
+     * @return The mapped size in bytes, a whole number of pages
+     */
+    size_t size() const {
+        return m_size;
+    }
+
+private:
+
+    /**
+     * @brief Apply an mbind policy over the given real nodes to part of the buffer
+     */
+    bool applyPolicy(int mode, const std::vector<int> &memoryNodes, size_t offset, size_t length);
+
+    char *m_data;       ///< The mapping
+    size_t m_size;      ///< Mapped size in bytes
+};
+
+/**
+ * @brief Restrict the calling thread to a node's CPUs
+ * @param topology [in]: The topology node refers to
+ * @param node [in]: The node
+ * @return Whether the thread was pinned
+ */
+inline bool pinThreadToNode(const NumaTopology &topology, size_t node) {
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    for (int cpu : topology.cpus(node)) {
+        CPU_SET(cpu, &cpuSet);
+    }
+    return sched_setaffinity(0, sizeof(cpuSet), &cpuSet) == 0;
+}
+
+/**
+ * @brief Run threadsPerNode threads pinned to each node, and wait for all of them
+ * @param topology [in]: The nodes to run on
+ * @param threadsPerNode [in]: Threads per node
+ * @param worker [in]: Called as worker(node, threadIndex) on each thread, threadIndex counting up from 0 per node
+ */
+template <typename Worker>
+void runPinnedWorkers(const NumaTopology &topology, size_t threadsPerNode, Worker worker) {
+    std::vector<std::thread> threads;
+    for (size_t node = 0; node < topology.numNodes(); ++node) {
+        for (size_t thread = 0; thread < threadsPerNode; ++thread) {
+            threads.emplace_back([&topology, &worker, node, thread]() {
+                if (!pinThreadToNode(topology, node)) {
+                    std::cerr << "Could not pin a worker to NUMA node " << node << std::endl;
+                }
+                worker(node, thread);
+            });
+        }
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
+
+inline NumaTopology NumaTopology::detect() {
+    NumaTopology topology;
+
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        for (unsigned int cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu) {
+            CPU_SET(cpu, &allowed);
+        }
+    }
+    auto addNode = [&](int memoryNode, const std::vector<int> &cpus) {
+        std::vector<int> usable;
+        for (int cpu : cpus) {
+            if (cpu >= 0 && cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+                usable.push_back(cpu);
+            }
+        }
+        // Memory only nodes (and nodes we may not run on) can't host workers
+        if (!usable.empty()) {
+            topology.m_nodeCpus.push_back(usable);
+            topology.m_memoryNodes.push_back(memoryNode);
+        }
+    };
+
+#ifdef LEARNED_INDICES_USE_LIBNUMA
+    if (numa_available() >= 0) {
+        struct bitmask *cpuMask = numa_allocate_cpumask();
+        for (int node = 0; node <= numa_max_node(); ++node) {
+            if (numa_node_to_cpus(node, cpuMask) != 0) {
+                continue;
+            }
+            std::vector<int> cpus;
+            for (int cpu = 0; cpu < numa_num_possible_cpus(); ++cpu) {
+                if (numa_bitmask_isbitset(cpuMask, cpu)) {
+                    cpus.push_back(cpu);
+                }
+            }
+            addNode(node, cpus);
+        }
+        numa_free_cpumask(cpuMask);
+    }
+#else
+    std::ifstream onlineFile("/sys/devices/system/node/online");
+    std::string online;
+    if (std::getline(onlineFile, online)) {
+        for (int node : parseList(online)) {
+            std::ifstream cpuFile("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            std::string cpuList;
+            std::getline(cpuFile, cpuList);
+            addNode(node, parseList(cpuList));
+        }
+    }
+#endif
+
+    if (topology.m_nodeCpus.empty()) {
+        std::vector<int> cpus;
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                cpus.push_back(cpu);
+            }
+        }
+        topology.m_nodeCpus.push_back(cpus);
+        topology.m_memoryNodes.push_back(0);
+    }
+    return topology;
+}
+
+inline NumaTopology NumaTopology::withNodes(size_t numNodes) {
+    NumaTopology machine = detect();
+    if (numNodes == 0 || numNodes == machine.numNodes()) {
+        return machine;
+    }
+
+    NumaTopology topology;
+    if (numNodes < machine.numNodes()) {
+        topology.m_nodeCpus.assign(machine.m_nodeCpus.begin(), machine.m_nodeCpus.begin() + numNodes);
+        topology.m_memoryNodes.assign(machine.m_memoryNodes.begin(), machine.m_memoryNodes.begin() + numNodes);
+        return topology;
+    }
+
+    // Split the machine's CPUs, in node order, into numNodes contiguous groups. With fewer CPUs than nodes
+    // the groups share CPUs
+    std::vector<int> cpus;
+    for (const auto &nodeCpus : machine.m_nodeCpus) {
+        cpus.insert(cpus.end(), nodeCpus.begin(), nodeCpus.end());
+    }
+    topology.m_emulated = true;
+    for (size_t node = 0; node < numNodes; ++node) {
+        std::vector<int> group(cpus.begin() + node * cpus.size() / numNodes,
+                               cpus.begin() + (node + 1) * cpus.size() / numNodes);
+        if (group.empty()) {
+            group.push_back(cpus[node % cpus.size()]);
+        }
+        topology.m_nodeCpus.push_back(group);
+        topology.m_memoryNodes.push_back(machine.m_memoryNodes[node % machine.numNodes()]);
+    }
+    return topology;
+}
+
+inline std::vector<int> NumaTopology::parseList(const std::string &list) {
+    std::vector<int> values;
+    std::stringstream stream(list);
+    std::string range;
+    while (std::getline(stream, range, ',')) {
+        int first = 0, last = 0;
+        int numParsed = std::sscanf(range.c_str(), "%d-%d", &first, &last);
+        if (numParsed < 1) {
+            continue;
+        }
+        last = numParsed == 2 ? last : first;
+        for (int value = first; value <= last; ++value) {
+            values.push_back(value);
+        }
+    }
+    return values;
+}
+
+inline NumaBuffer::NumaBuffer(size_t bytes): m_data(nullptr), m_size(0) {
+    const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t size = std::max(pageSize, (bytes + pageSize - 1) / pageSize * pageSize);
+    void *mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    m_data = static_cast<char *>(mapping);
+    m_size = size;
+}
+
+inline bool NumaBuffer::bindToNode(const NumaTopology &topology, size_t node, size_t offset, size_t length) {
+    return applyPolicy(MPOL_BIND, {topology.memoryNode(node)}, offset, length);
+}
+
+inline bool NumaBuffer::interleave(const NumaTopology &topology) {
+    std::vector<int> memoryNodes;
+    for (size_t node = 0; node < topology.numNodes(); ++node) {
+        memoryNodes.push_back(topology.memoryNode(node));
+    }
+    return applyPolicy(MPOL_INTERLEAVE, memoryNodes, 0, m_size);
+}
+
+inline bool NumaBuffer::applyPolicy(int mode, const std::vector<int> &memoryNodes, size_t offset, size_t length) {
+    const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t start = std::min(offset / pageSize * pageSize, m_size);
+    const size_t end = std::min((offset + length + pageSize - 1) / pageSize * pageSize, m_size);
+    if (start >= end) {
+        return true;
+    }
+
+#ifdef LEARNED_INDICES_USE_LIBNUMA
+    if (numa_available() < 0) {
+        return false;
+    }
+    struct bitmask *nodeMask = numa_allocate_nodemask();
+    for (int memoryNode : memoryNodes) {
+        numa_bitmask_setbit(nodeMask, memoryNode);
+    }
+    if (mode == MPOL_INTERLEAVE) {
+        numa_interleave_memory(m_data + start, end - start, nodeMask);
+    } else {
+        numa_tonode_memory(m_data + start, end - start, memoryNodes.front());
+    }
+    numa_free_nodemask(nodeMask);
+    return true;
+#else
+    // The kernel reads the node mask as whole unsigned longs, maxNode bits of it
+    const size_t bitsPerWord = 8 * sizeof(unsigned long);
+    int maxMemoryNode = *std::max_element(memoryNodes.begin(), memoryNodes.end());
+    std::vector<unsigned long> nodeMask(maxMemoryNode / bitsPerWord + 1, 0);
+    for (int memoryNode : memoryNodes) {
+        nodeMask[memoryNode / bitsPerWord] |= 1UL << (memoryNode % bitsPerWord);
+    }
+    unsigned long maxNode = nodeMask.size() * bitsPerWord;
+    if (syscall(SYS_mbind, m_data + start, end - start, mode, nodeMask.data(), maxNode, 0) != 0) {
+        std::cerr << "mbind failed, memory stays where it is first touched: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+#endif
+}
+
+#endif //LEARNED_INDICES_NUMA_H
@@ -0,0 +1,208 @@
+/**
+ * @file QuantizedModel.h
+ *
+ * @brief Fixed point copies of the trained models, so integer keys are routed and positioned without floats
+ *
+ * A QuantizedLinearModel computes (intercept + delta * slope) >> fractionBits, where delta is the key's offset
+ * from the smallest key the model covers, clamped to the keys it covers and shifted down to 32 bits. The slope
+ * fits in 32 bits as well, so evaluating a model is one 32 x 32 -> 64 bit multiply, an add and a shift.
+ *
+ * The first stage network has a single input, so it is exactly a piecewise linear function of the key with a
+ * breakpoint wherever a hidden neuron switches on or off. QuantizedPiecewiseLinearModel stores it as integer
+ * breakpoints and one QuantizedLinearModel per segment.
+ *
+ * Quantized predictions differ slightly from the float models they were made from, so error bounds have to be
+ * recomputed against the quantized models. Negative values rely on >> being an arithmetic shift.
+ *
+ * @date 10/19/2026
+ */
+
+#ifndef LEARNED_INDICES_QUANTIZEDMODEL_H
+#define LEARNED_INDICES_QUANTIZEDMODEL_H
+
+#include "ModelWeights.h"
+#include <cmath>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <type_traits>
+
+/**
+ * @brief A linear model of an integer key in fixed point
+ * @tparam KeyType [in]: An integer key type
+ */
+template <typename KeyType>
+struct QuantizedLinearModel {
+    static_assert(std::is_integral<KeyType>::value, "Fixed point models need integer keys");
+
+    KeyType baseKey = KeyType();    ///< Smallest key the model covers, deltas are measured from it
+    uint64_t maxDelta = 0;          ///< Largest delta the model covers, larger ones are clamped to it
+    int keyShift = 0;               ///< Right shift that brings any clamped delta into 32 bits
+    int fractionBits = 0;           ///< Fraction bits of slope and intercept
+    int64_t slope = 0;              ///< Output per shifted delta, fixed point, below 2^31 in magnitude
+    int64_t intercept = 0;          ///< Output at baseKey, fixed point
+
+    /**
+     * @brief Quantize a model covering keys minKey to maxKey
+     * @param slope [in]: Output per key
+     * @param valueAtMinKey [in]: Output at minKey
+     * @param minKey [in]: Smallest key the model covers
+     * @param maxKey [in]: Largest key the model covers
+     * @return The fixed point model, with as many fraction bits as fit without overflow
+     */
+    static QuantizedLinearModel fit(double slope, double valueAtMinKey, KeyType minKey, KeyType maxKey);
+
+    /**
+     * @brief Evaluate the model with integer arithmetic only
+     * @param key [in]: The key
+     * @return The output, rounded down
+     */
+    int64_t predict(KeyType key) const {
+        uint64_t delta = key > baseKey ? static_cast<uint64_t>(key) - static_cast<uint64_t>(baseKey) : 0;
+        delta = std::min(delta, maxDelta) >> keyShift;
+        return (intercept + static_cast<int64_t>(delta) * slope) >> fractionBits;
+    }
+};
+
+/**
+ * @brief The first stage network as integer breakpoints and a fixed point linear model per segment
+ * @tparam KeyType [in]: An integer key type
+ */
+template <typename KeyType>
+struct QuantizedPiecewiseLinearModel {
+    std::vector<KeyType> breakpoints;                       ///< First key of every segment but the first, sorted
+    std::vector<QuantizedLinearModel<KeyType>> segments;    ///< One more model than breakpoints
+
+    /**
+     * @brief Convert a first stage network, covering keys minKey to maxKey
+     * @param weights [in]: The first stage parameters
+     * @param outputScale [in]: Multiplies the network output, e.g. the number of second stage nodes
+     * @param minKey [in]: Smallest key to cover
+     * @param maxKey [in]: Largest key to cover
+     * @return The quantized network
+     */
+    static QuantizedPiecewiseLinearModel fromFirstStage(const FirstStageWeights &weights, double outputScale,
+                                                        KeyType minKey, KeyType maxKey);
+
+    /**
+     * @brief Evaluate the network with integer arithmetic only
+     * @param key [in]: The key
+     * @return The scaled output, rounded down
+     */
+    int64_t predict(KeyType key) const {
+        // Counting rather than searching keeps this branch free, there are at most numNeurons breakpoints
+        size_t segment = 0;
+        for (size_t ii = 0; ii < breakpoints.size(); ++ii) {
+            segment += key >= breakpoints[ii];
+        }
+        return segments[segment].predict(key);
+    }
+};
+
+/**
+ * @brief Stands in for the fixed point models when keys aren't integers, so indexes over such keys still compile.
+ * It is never used: RecursiveModelIndex rejects enableQuantizedInference() at compile time for them
+ * @tparam KeyType [in]: A non integer key type
+ */
+template <typename KeyType>
+struct NoQuantizedModel {
+    static NoQuantizedModel fit(double, double, KeyType, KeyType) {
+        return NoQuantizedModel();
+    }
+
+    static NoQuantizedModel fromFirstStage(const FirstStageWeights &, double, KeyType, KeyType) {
+        return NoQuantizedModel();
+    }
+
+    int64_t predict(KeyType) const {
+        return 0;
+    }
+};
+
+/// Fixed point second stage model for a key type: a QuantizedLinearModel for integer keys, a NoQuantizedModel otherwise
+template <typename KeyType>
+using QuantizedLinearModelFor = typename std::conditional<std::is_integral<KeyType>::value,
+                                                          QuantizedLinearModel<KeyType>, NoQuantizedModel<KeyType>>::type;
+
+/// Fixed point first stage for a key type: a QuantizedPiecewiseLinearModel for integer keys, a NoQuantizedModel otherwise
+template <typename KeyType>
+using QuantizedPiecewiseLinearModelFor = typename std::conditional<std::is_integral<KeyType>::value,
+                                                                   QuantizedPiecewiseLinearModel<KeyType>,
+                                                                   NoQuantizedModel<KeyType>>::type;
+
+template <typename KeyType>
+QuantizedLinearModel<KeyType> QuantizedLinearModel<KeyType>::fit(double slope, double valueAtMinKey,
+                                                                 KeyType minKey, KeyType maxKey) {
+    QuantizedLinearModel model;
+    model.baseKey = minKey;
+    model.maxDelta = maxKey > minKey ? static_cast<uint64_t>(maxKey) - static_cast<uint64_t>(minKey) : 0;
+    while ((model.maxDelta >> model.keyShift) > 0xFFFFFFFFull) {
+        model.keyShift++;
+    }
+
+    // An untrained model can produce anything, keep it finite and in range so it just gets large error bounds
+    const double limit = std::ldexp(1.0, 61);
+    slope = std::isfinite(slope) ? slope : 0;
+    valueAtMinKey = std::isfinite(valueAtMinKey) ? std::max(-limit, std::min(limit, valueAtMinKey)) : 0;
+
+    double shiftedSlope = std::ldexp(slope, model.keyShift);
+    double maxShiftedDelta = static_cast<double>(model.maxDelta >> model.keyShift);
+    if (std::abs(shiftedSlope) * maxShiftedDelta >= limit || std::abs(shiftedSlope) >= std::ldexp(1.0, 31)) {
+        shiftedSlope = 0;
+    }
+
+    // Each term below 2^62 keeps intercept + delta * slope inside an int64_t
+    for (model.fractionBits = 62; model.fractionBits > 0; --model.fractionBits) {
+        if (std::ldexp(std::abs(shiftedSlope), model.fractionBits) < std::ldexp(1.0, 31) &&
+            std::ldexp(std::abs(shiftedSlope) * maxShiftedDelta, model.fractionBits) < std::ldexp(1.0, 62) &&
+            std::ldexp(std::abs(valueAtMinKey), model.fractionBits) < std::ldexp(1.0, 62)) {
+            break;
+        }
+    }
+    model.slope = static_cast<int64_t>(std::llround(std::ldexp(shiftedSlope, model.fractionBits)));
+    model.intercept = static_cast<int64_t>(std::llround(std::ldexp(valueAtMinKey, model.fractionBits)));
+    return model;
+}
+
+template <typename KeyType>
+QuantizedPiecewiseLinearModel<KeyType> QuantizedPiecewiseLinearModel<KeyType>::fromFirstStage(
+        const FirstStageWeights &weights, double outputScale, KeyType minKey, KeyType maxKey) {
+    const size_t numNeurons = weights.numNeurons();
+    QuantizedPiecewiseLinearModel model;
+
+    // A neuron switches at key = -bias / weight. Segments start at the first integer key past each switch
+    for (size_t jj = 0; jj < numNeurons; ++jj) {
+        if (weights.hiddenWeight[jj] == 0) {
+            continue;
+        }
+        double breakpoint = std::ceil(-static_cast<double>(weights.hiddenBias[jj]) / weights.hiddenWeight[jj]);
+        if (breakpoint > static_cast<double>(minKey) && breakpoint < static_cast<double>(maxKey)) {
+            model.breakpoints.push_back(static_cast<KeyType>(breakpoint));
+        }
+    }
+    std::sort(model.breakpoints.begin(), model.breakpoints.end());
+    model.breakpoints.erase(std::unique(model.breakpoints.begin(), model.breakpoints.end()), model.breakpoints.end());
+
+    for (size_t segment = 0; segment <= model.breakpoints.size(); ++segment) {
+        KeyType low = segment == 0 ? minKey : model.breakpoints[segment - 1];
+        KeyType high = segment == model.breakpoints.size() ? maxKey : model.breakpoints[segment] - 1;
+        high = std::max(low, high);
+
+        // The same neurons are active across the whole segment, so check which at its middle
+        double middle = static_cast<double>(low) / 2 + static_cast<double>(high) / 2;
+        double slope = 0;
+        double valueAtLow = weights.outputBias;
+        for (size_t jj = 0; jj < numNeurons; ++jj) {
+            if (weights.hiddenWeight[jj] * middle + weights.hiddenBias[jj] > 0) {
+                slope += static_cast<double>(weights.outputWeight[jj]) * weights.hiddenWeight[jj];
+                valueAtLow += static_cast<double>(weights.outputWeight[jj]) *
+                              (static_cast<double>(weights.hiddenWeight[jj]) * static_cast<double>(low) + weights.hiddenBias[jj]);
+            }
+        }
+        model.segments.push_back(QuantizedLinearModel<KeyType>::fit(slope * outputScale, valueAtLow * outputScale,
+                                                                     low, high));
+    }
+    return model;
+}
+
+#endif //LEARNED_INDICES_QUANTIZEDMODEL_H
@@ -0,0 +1,175 @@
+/**
+ * @file Snapshot.h
+ *
+ * @brief Durable snapshots of the sorted data, taken by train() so the write ahead log can be truncated
+ *
+ * A snapshot is a header, the (key, value) pairs and a trailing checksum:
+ *
+ *     "LISNAP01" | key size (u32) | value size (u32) | last logged sequence number (u64) | count (u64)
+ *     count x (key | value)
+ *     CRC-32 of everything above (u32)
+ *
+ * @date 10/18/2026
+ */
+
+#ifndef LEARNED_INDICES_SNAPSHOT_H
+#define LEARNED_INDICES_SNAPSHOT_H
+
+#include "Checksum.h"
+#include <string>
+#include <vector>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/**
+ * @brief Whether a snapshot (or any file) exists at path
+ */
+inline bool snapshotExists(const std::string &path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0;
+}
+
+/**
+ * @brief Durably replace the snapshot at path. The data goes to a temporary file that is synced and renamed
+ * over the old snapshot, so a crash leaves either the old or the new snapshot, never a partial one
+ * @param path [in]: The snapshot file
+ * @param data [in]: The (key, value) pairs
+ * @param sequenceNumber [in]: The last write ahead log record the data contains
+ * @return Whether the snapshot is durable
+ */
+template <typename DataVector>
+bool saveSnapshot(const std::string &path, const DataVector &data, uint64_t sequenceNumber) {
+    typedef typename DataVector::value_type::first_type KeyType;
+    typedef typename DataVector::value_type::second_type ValueType;
+    const size_t pairSize = sizeof(KeyType) + sizeof(ValueType);
+
+    const std::string temporaryPath = path + ".tmp";
+    int fd = ::open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Could not create snapshot " << temporaryPath << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    uint32_t checksum = 0;
+    bool written = true;
+    std::vector<uint8_t> buffer;
+    auto writeBuffer = [&]() {
+        for (size_t offset = 0; written && offset < buffer.size();) {
+            ssize_t result = write(fd, buffer.data() + offset, buffer.size() - offset);
+            if (result < 0 && errno == EINTR) {
+                continue;
+            }
+            written = result > 0;
+            offset += written ? static_cast<size_t>(result) : 0;
+        }
+        buffer.clear();
+    };
+    auto flush = [&]() {
+        checksum = crc32(buffer.data(), buffer.size(), checksum);
+        writeBuffer();
+    };
+    auto append = [&](const void *bytes, size_t size) {
+        buffer.insert(buffer.end(), static_cast<const uint8_t *>(bytes), static_cast<const uint8_t *>(bytes) + size);
+    };
+
+    uint32_t keySize = sizeof(KeyType);
+    uint32_t valueSize = sizeof(ValueType);
+    uint64_t count = data.size();
+    append("LISNAP01", 8);
+    append(&keySize, 4);
+    append(&valueSize, 4);
+    append(&sequenceNumber, 8);
+    append(&count, 8);
+
+    // Write in chunks of about a megabyte rather than buffering the whole dataset
+    const size_t pairsPerChunk = (1 << 20) / pairSize + 1;
+    for (size_t ii = 0; ii < data.size() && written; ++ii) {
+        append(&data[ii].first, sizeof(KeyType));
+        append(&data[ii].second, sizeof(ValueType));
+        if ((ii + 1) % pairsPerChunk == 0) {
+            flush();
+        }
+    }
+    flush();
+    append(&checksum, 4);
+    writeBuffer();
+
+    written = written && fsync(fd) == 0;
+    written = ::close(fd) == 0 && written;
+    if (!written || rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        std::cerr << "Could not write snapshot " << path << ": " << std::strerror(errno) << std::endl;
+        unlink(temporaryPath.c_str());
+        return false;
+    }
+
+    // The rename is only durable once the directory is synced
+    size_t slash = path.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+    int directoryFd = ::open(directory.c_str(), O_RDONLY);
+    if (directoryFd >= 0) {
+        fsync(directoryFd);
+        ::close(directoryFd);
+    }
+    return true;
+}
+
+/**
+ * @brief Read a snapshot, checking its checksum
+ * @param path [in]: The snapshot file
+ * @param data [out]: The (key, value) pairs
+ * @param sequenceNumber [out]: The last write ahead log record the data contains
+ * @return Whether the snapshot was intact. On failure data and sequenceNumber are unchanged
+ */
+template <typename DataVector>
+bool loadSnapshot(const std::string &path, DataVector &data, uint64_t &sequenceNumber) {
+    typedef typename DataVector::value_type::first_type KeyType;
+    typedef typename DataVector::value_type::second_type ValueType;
+    const size_t headerSize = 8 + 4 + 4 + 8 + 8;
+    const size_t pairSize = sizeof(KeyType) + sizeof(ValueType);
+
+    std::ifstream file(path, std::ios::binary);
+    std::vector<uint8_t> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (!file.eof() && !file) {
+        std::cerr << "Could not read snapshot " << path << std::endl;
+        return false;
+    }
+
+    uint32_t keySize = 0, valueSize = 0, checksum = 0;
+    uint64_t snapshotSequenceNumber = 0, count = 0;
+    bool valid = contents.size() >= headerSize + 4 && std::memcmp(contents.data(), "LISNAP01", 8) == 0;
+    if (valid) {
+        std::memcpy(&keySize, &contents[8], 4);
+        std::memcpy(&valueSize, &contents[12], 4);
+        std::memcpy(&snapshotSequenceNumber, &contents[16], 8);
+        std::memcpy(&count, &contents[24], 8);
+        std::memcpy(&checksum, &contents[contents.size() - 4], 4);
+        valid = keySize == sizeof(KeyType) && valueSize == sizeof(ValueType) &&
+                contents.size() == headerSize + count * pairSize + 4 &&
+                checksum == crc32(contents.data(), contents.size() - 4);
+    }
+    if (!valid) {
+        std::cerr << "Corrupt snapshot, or not a snapshot of this key and value type: " << path << std::endl;
+        return false;
+    }
+
+    sequenceNumber = snapshotSequenceNumber;
+    data.clear();
+    data.reserve(count);
+    const uint8_t *pair = &contents[headerSize];
+    for (uint64_t ii = 0; ii < count; ++ii, pair += pairSize) {
+        KeyType key;
+        ValueType value;
+        std::memcpy(&key, pair, sizeof(KeyType));
+        std::memcpy(&value, pair + sizeof(KeyType), sizeof(ValueType));
+        data.push_back({key, value});
+    }
+    return true;
+}
+
+#endif //LEARNED_INDICES_SNAPSHOT_H
@@ -0,0 +1,364 @@
+/**
+ * @file WriteAheadLog.h
+ *
+ * @brief An append only, group committed log of inserts, so buffered inserts survive a crash
+ *
+ * The log is a header followed by fixed size records:
+ *
+ *     header: "LIWAL001" | key size (u32) | value size (u32) | first sequence number (u64) | CRC-32 (u32)
+ *     record: sequence number (u64) | key | value | CRC-32 of the preceding fields (u32)
+ *
+ * Sequence numbers increase by one per record and keep counting across truncations, so a snapshot can record
+ * the last sequence number it contains and replay can skip everything up to it.
+ *
+ * @date 10/18/2026
+ */
+
+#ifndef LEARNED_INDICES_WRITEAHEADLOG_H
+#define LEARNED_INDICES_WRITEAHEADLOG_H
+
+#include "Checksum.h"
+#include <string>
+#include <vector>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+#include <type_traits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/**
+ * @brief A container for the parameters of the write ahead log
+ */
+struct WriteAheadLogParameters {
+    std::string logPath;            ///< The insert log
+    std::string snapshotPath;       ///< Where train() persists the sorted data before truncating the log
+    size_t syncBatchSize = 64;      ///< Inserts per write + fdatasync. 1 makes every insert durable when insert returns
+    size_t maxLogRecords = 1 << 20; ///< Records at which an insert snapshots the index and truncates the log (0 for never)
+};
+
+/**
+ * @brief An append only log of (key, value) inserts in a local file
+ *
+ * Appends are buffered and written with one fdatasync per syncBatchSize records (group commit), so a crash
+ * loses at most the last syncBatchSize - 1 inserts unless sync() is called. A torn or corrupt tail, from a
+ * crash mid write, is detected by its checksum and cut off on open.
+ *
+ * @tparam KeyType [in]: Key type of the records
+ * @tparam ValueType [in]: Value type of the records
+ */
+template <typename KeyType, typename ValueType>
+class WriteAheadLog {
+    static_assert(std::is_trivially_copyable<KeyType>::value && std::is_trivially_copyable<ValueType>::value,
+                  "Log records store keys and values as raw bytes");
+
+public:
+
+    WriteAheadLog(): m_fd(-1), m_syncBatchSize(1), m_firstSequenceNumber(1), m_nextSequenceNumber(1), m_numPending(0) {}
+
+    ~WriteAheadLog() {
+        close();
+    }
+
+    WriteAheadLog(const WriteAheadLog &) = delete;
+    WriteAheadLog &operator=(const WriteAheadLog &) = delete;
+
+    /**
+     * @brief Open (or create) a log, replaying every intact record in it
+     * @param path [in]: The log file
+     * @param syncBatchSize [in]: Records per write + fdatasync
+     * @param replay [in]: Called as replay(sequenceNumber, key, value) for each record, in order
+     * @return Whether the log was opened. Fails if the file is not a log of this key and value type
+     */
+    template <typename ReplayFunction>
+    bool open(const std::string &path, size_t syncBatchSize, ReplayFunction replay);
+
+    /**
+     * @brief Append an insert. It is durable once the batch it is in is synced
+     * @param key [in]: The inserted key
+     * @param value [in]: The inserted value
+     * @return Whether the record was buffered (and written, if it completed a batch)
+     */
+    bool append(KeyType key, ValueType value);
+
+    /**
+     * @brief Write and fdatasync every buffered record
+     * @return Whether the records are durable
+     */
+    bool sync();
+
+    /**
+     * @brief Drop every record, once they are all in a durable snapshot. The empty log is written to a temporary
+     * file and renamed over the log, so a crash leaves either the old or the empty log. On failure the log is
+     * closed, since its numbering no longer matches the file, and appends fail until it is opened again
+     * @param nextSequenceNumber [in]: Number the next record at least this
+     * @return Whether the empty log is durable
+     */
+    bool truncate(uint64_t nextSequenceNumber = 0);
+
+    /**
+     * @brief Sync and close the log
+     */
+    void close();
+
+    /**
+     * @return Whether the log is open for appends
+     */
+    bool isOpen() const {
+        return m_fd >= 0;
+    }
+
+    /**
+     * @return Sequence number of the latest record, 0 if there never was one
+     */
+    uint64_t lastSequenceNumber() const {
+        return m_nextSequenceNumber - 1;
+    }
+
+    /**
+     * @return Number of records in the log since it was created or last truncated, including buffered ones
+     */
+    uint64_t numRecords() const {
+        return m_nextSequenceNumber - m_firstSequenceNumber;
+    }
+
+private:
+    static const size_t HEADER_SIZE = 8 + 4 + 4 + 8 + 4;
+    static const size_t RECORD_SIZE = 8 + sizeof(KeyType) + sizeof(ValueType) + 4;
+
+    /**
+     * @brief Write a header numbering records from firstSequenceNumber to fd
+     */
+    bool writeHeader(int fd, uint64_t firstSequenceNumber);
+
+    /**
+     * @brief Write a whole buffer to fd, retrying short writes
+     */
+    bool writeAll(int fd, const uint8_t *data, size_t size);
+
+    int m_fd;                           ///< The log file, -1 when closed
+    std::string m_path;                 ///< Path of the log file
+    size_t m_syncBatchSize;             ///< Records per write + fdatasync
+    uint64_t m_firstSequenceNumber;     ///< Sequence number of the first record in the file
+    uint64_t m_nextSequenceNumber;      ///< Sequence number of the next record
+    std::vector<uint8_t> m_pending;     ///< Encoded records not written yet
+    size_t m_numPending;                ///< Number of records in m_pending
+};
+
+template <typename KeyType, typename ValueType>
+template <typename ReplayFunction>
+bool WriteAheadLog<KeyType, ValueType>::open(const std::string &path, size_t syncBatchSize, ReplayFunction replay) {
+    close();
+
+    // O_APPEND, so writes go to the end even right after a truncate
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        std::cerr << "Could not open write ahead log " << path << ": " << std::strerror(errno) << std::endl;
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        return false;
+    }
+
+    std::vector<uint8_t> contents(static_cast<size_t>(info.st_size));
+    size_t bytesRead = 0;
+    while (bytesRead < contents.size()) {
+        ssize_t result = pread(fd, contents.data() + bytesRead, contents.size() - bytesRead, bytesRead);
+        if (result <= 0) {
+            break;
+        }
+        bytesRead += static_cast<size_t>(result);
+    }
+    contents.resize(bytesRead);
+
+    m_fd = fd;
+    m_path = path;
+    m_syncBatchSize = std::max(syncBatchSize, static_cast<size_t>(1));
+    m_firstSequenceNumber = 1;
+    m_nextSequenceNumber = 1;
+    m_pending.clear();
+    m_numPending = 0;
+
+    if (contents.empty()) {
+        if (!writeHeader(m_fd, m_nextSequenceNumber) || fdatasync(m_fd) != 0) {
+            std::cerr << "Could not initialize write ahead log " << path << std::endl;
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    uint32_t keySize, valueSize, headerChecksum;
+    uint64_t firstSequenceNumber;
+    if (contents.size() >= HEADER_SIZE) {
+        std::memcpy(&keySize, &contents[8], 4);
+        std::memcpy(&valueSize, &contents[12], 4);
+        std::memcpy(&firstSequenceNumber, &contents[16], 8);
+        std::memcpy(&headerChecksum, &contents[24], 4);
+    }
+    if (contents.size() < HEADER_SIZE || std::memcmp(contents.data(), "LIWAL001", 8) != 0 ||
+        headerChecksum != crc32(contents.data(), HEADER_SIZE - 4) ||
+        keySize != sizeof(KeyType) || valueSize != sizeof(ValueType)) {
+        std::cerr << "Not a write ahead log of this key and value type: " << path << std::endl;
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+
+    // Replay up to the first record that doesn't check out, anything after it was never fully written
+    m_firstSequenceNumber = firstSequenceNumber;
+    m_nextSequenceNumber = firstSequenceNumber;
+    size_t offset = HEADER_SIZE;
+    for (; offset + RECORD_SIZE <= contents.size(); offset += RECORD_SIZE) {
+        const uint8_t *record = &contents[offset];
+        uint64_t sequenceNumber;
+        uint32_t checksum;
+        std::memcpy(&sequenceNumber, record, 8);
+        std::memcpy(&checksum, record + RECORD_SIZE - 4, 4);
+        if (checksum != crc32(record, RECORD_SIZE - 4) || sequenceNumber != m_nextSequenceNumber) {
+            break;
+        }
+
+        KeyType key;
+        ValueType value;
+        std::memcpy(&key, record + 8, sizeof(KeyType));
+        std::memcpy(&value, record + 8 + sizeof(KeyType), sizeof(ValueType));
+        replay(sequenceNumber, key, value);
+        m_nextSequenceNumber++;
+    }
+
+    if (offset < contents.size()) {
+        std::cerr << "Discarding " << contents.size() - offset << " bytes of torn write ahead log tail" << std::endl;
+        if (ftruncate(m_fd, static_cast<off_t>(offset)) != 0 || fdatasync(m_fd) != 0) {
+            std::cerr << "Could not cut the torn tail off " << path << std::endl;
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename KeyType, typename ValueType>
+bool WriteAheadLog<KeyType, ValueType>::append(KeyType key, ValueType value) {
+    if (m_fd < 0) {
+        return false;
+    }
+
+    uint8_t record[RECORD_SIZE];
+    uint64_t sequenceNumber = m_nextSequenceNumber++;
+    std::memcpy(record, &sequenceNumber, 8);
+    std::memcpy(record + 8, &key, sizeof(KeyType));
+    std::memcpy(record + 8 + sizeof(KeyType), &value, sizeof(ValueType));
+    uint32_t checksum = crc32(record, RECORD_SIZE - 4);
+    std::memcpy(record + RECORD_SIZE - 4, &checksum, 4);
+
+    m_pending.insert(m_pending.end(), record, record + RECORD_SIZE);
+    if (++m_numPending >= m_syncBatchSize) {
+        return sync();
+    }
+    return true;
+}
+
+template <typename KeyType, typename ValueType>
+bool WriteAheadLog<KeyType, ValueType>::sync() {
+    if (m_fd < 0) {
+        return false;
+    }
+    if (m_pending.empty()) {
+        return true;
+    }
+
+    bool written = writeAll(m_fd, m_pending.data(), m_pending.size()) && fdatasync(m_fd) == 0;
+    if (!written) {
+        std::cerr << "Write ahead log sync failed: " << std::strerror(errno) << std::endl;
+    }
+    m_pending.clear();
+    m_numPending = 0;
+    return written;
+}
+
+template <typename KeyType, typename ValueType>
+bool WriteAheadLog<KeyType, ValueType>::truncate(uint64_t nextSequenceNumber) {
+    if (m_fd < 0) {
+        return false;
+    }
+
+    // Buffered records are covered by the snapshot too, no need to write them
+    m_pending.clear();
+    m_numPending = 0;
+    m_nextSequenceNumber = std::max(m_nextSequenceNumber, nextSequenceNumber);
+
+    // Truncating in place would leave a headerless file, which open rejects, if we crashed before the header
+    const std::string temporaryPath = m_path + ".tmp";
+    int fd = ::open(temporaryPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    bool written = fd >= 0 && writeHeader(fd, m_nextSequenceNumber) && fdatasync(fd) == 0;
+    if (!written || rename(temporaryPath.c_str(), m_path.c_str()) != 0) {
+        std::cerr << "Write ahead log truncate failed, closing the log: " << std::strerror(errno) << std::endl;
+        if (fd >= 0) {
+            ::close(fd);
+            unlink(temporaryPath.c_str());
+        }
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+
+    // The rename is only durable once the directory is synced
+    size_t slash = m_path.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "." : (slash == 0 ? "/" : m_path.substr(0, slash));
+    int directoryFd = ::open(directory.c_str(), O_RDONLY);
+    if (directoryFd >= 0) {
+        fsync(directoryFd);
+        ::close(directoryFd);
+    }
+
+    ::close(m_fd);
+    m_fd = fd;
+    m_firstSequenceNumber = m_nextSequenceNumber;
+    return true;
+}
+
+template <typename KeyType, typename ValueType>
+void WriteAheadLog<KeyType, ValueType>::close() {
+    if (m_fd >= 0) {
+        sync();
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+template <typename KeyType, typename ValueType>
+bool WriteAheadLog<KeyType, ValueType>::writeHeader(int fd, uint64_t firstSequenceNumber) {
+    uint8_t header[HEADER_SIZE];
+    uint32_t keySize = sizeof(KeyType);
+    uint32_t valueSize = sizeof(ValueType);
+    std::memcpy(header, "LIWAL001", 8);
+    std::memcpy(header + 8, &keySize, 4);
+    std::memcpy(header + 12, &valueSize, 4);
+    std::memcpy(header + 16, &firstSequenceNumber, 8);
+    uint32_t checksum = crc32(header, HEADER_SIZE - 4);
+    std::memcpy(header + HEADER_SIZE - 4, &checksum, 4);
+    return writeAll(fd, header, HEADER_SIZE);
+}
+
+template <typename KeyType, typename ValueType>
+bool WriteAheadLog<KeyType, ValueType>::writeAll(int fd, const uint8_t *data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+#endif //LEARNED_INDICES_WRITEAHEADLOG_H
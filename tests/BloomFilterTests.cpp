@@ -0,0 +1,77 @@
+/**
+ * @file BloomFilterTests.cpp
+ *
+ * @breif Tests of the existence filter used by the Recursive Model Index
+ *
+ * @date 10/18/2026
+ * @author Ben Caine
+ */
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE BloomFilterTests
+
+#include <boost/test/unit_test.hpp>
+#include "../src/utils/BloomFilter.h"
+
+BOOST_AUTO_TEST_CASE(bloom_filter_no_false_negatives) {
+    const size_t numKeys = 100000;
+    ExistenceFilterParameters params;
+    params.falsePositiveRate = 0.01;
+
+    BloomFilter<long> filter(numKeys, params);
+    for (size_t ii = 0; ii < numKeys; ++ii) {
+        filter.insert(static_cast<long>(ii * 2));
+    }
+
+    for (size_t ii = 0; ii < numKeys; ++ii) {
+        BOOST_REQUIRE(filter.mayContain(static_cast<long>(ii * 2)));
+    }
+
+    // Odd keys were never inserted, so anything we let through is a false positive
+    size_t falsePositives = 0;
+    for (size_t ii = 0; ii < numKeys; ++ii) {
+        if (filter.mayContain(static_cast<long>(ii * 2 + 1))) {
+            falsePositives++;
+        }
+    }
+
+    double falsePositiveRate = static_cast<double>(falsePositives) / numKeys;
+    std::cout << "False positive rate: " << falsePositiveRate << std::endl;
+    BOOST_CHECK(falsePositiveRate < 0.02);
+}
+
+BOOST_AUTO_TEST_CASE(bloom_filter_memory_budget) {
+    const size_t numKeys = 100000;
+    ExistenceFilterParameters params;
+    params.falsePositiveRate = 0.001;
+    params.maxMemoryBytes = 16 * 1024;
+
+    BloomFilter<int> filter(numKeys, params);
+    BOOST_CHECK(filter.numBits() <= params.maxMemoryBytes * 8);
+
+    for (int ii = 0; ii < static_cast<int>(numKeys); ++ii) {
+        filter.insert(ii);
+    }
+    for (int ii = 0; ii < static_cast<int>(numKeys); ++ii) {
+        BOOST_REQUIRE(filter.mayContain(ii));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(bloom_filter_default_allows_everything) {
+    BloomFilter<int> filter;
+    BOOST_CHECK(filter.mayContain(42));
+}
+
+BOOST_AUTO_TEST_CASE(bloom_filter_rejects_invalid_false_positive_rate) {
+    for (float rate : {0.0f, -0.5f, 1.0f, 2.0f, std::nanf("")}) {
+        ExistenceFilterParameters params;
+        params.falsePositiveRate = rate;
+
+        // Rejected filters are disabled, they never reject a key
+        BloomFilter<int> filter(1000, params);
+        BOOST_CHECK_EQUAL(filter.numHashes(), 0);
+        filter.insert(1);
+        BOOST_CHECK(filter.mayContain(1));
+        BOOST_CHECK(filter.mayContain(2));
+    }
+}
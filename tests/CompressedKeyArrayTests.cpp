@@ -0,0 +1,63 @@
+/**
+ * @file CompressedKeyArrayTests.cpp
+ *
+ * @brief Tests of the frame of reference compressed key storage
+ *
+ * @date 10/18/2026
+ */
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE CompressedKeyArrayTests
+
+#include <boost/test/unit_test.hpp>
+#include <limits>
+#include <random>
+#include <algorithm>
+#include "../src/CompressedKeyArray.h"
+
+BOOST_AUTO_TEST_CASE(compressed_keys_decode_and_lower_bound) {
+    // Gaps that grow through the data, so blocks use every offset width
+    std::mt19937_64 rng(0);
+    std::vector<std::pair<long, long>> data;
+    long key = -1000;
+    for (size_t ii = 0; ii < 5000; ++ii) {
+        long maxGap = ii < 1000 ? 2 : ii < 2000 ? 300 : ii < 3000 ? 100000 : ii < 4000 ? (1L << 40) : 0;
+        key += static_cast<long>(rng() % (maxGap + 1));
+        data.push_back({key, static_cast<long>(ii)});
+    }
+
+    CompressedKeyArray<long> keys;
+    keys.build(data);
+    BOOST_REQUIRE_EQUAL(keys.size(), data.size());
+    BOOST_CHECK(keys.memoryUsage() < data.size() * sizeof(long));
+
+    std::vector<long> sortedKeys;
+    for (size_t ii = 0; ii < data.size(); ++ii) {
+        BOOST_REQUIRE_EQUAL(keys.get(ii), data[ii].first);
+        sortedKeys.push_back(data[ii].first);
+    }
+
+    // Compare against std::lower_bound over random windows, for stored and missing keys
+    for (size_t trial = 0; trial < 20000; ++trial) {
+        size_t start = rng() % data.size();
+        size_t end = std::min(data.size(), start + rng() % 600);
+        long query = data[rng() % data.size()].first + static_cast<long>(rng() % 3) - 1;
+
+        size_t expected = std::lower_bound(sortedKeys.begin() + start, sortedKeys.begin() + end, query) - sortedKeys.begin();
+        BOOST_REQUIRE_EQUAL(keys.lowerBound(start, end, query), expected);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(compressed_keys_full_range) {
+    std::vector<std::pair<long, long>> data = {{std::numeric_limits<long>::min(), 0}, {-1, 1}, {0, 2},
+                                               {std::numeric_limits<long>::max(), 3}};
+    CompressedKeyArray<long> keys;
+    keys.build(data);
+
+    for (size_t ii = 0; ii < data.size(); ++ii) {
+        BOOST_CHECK_EQUAL(keys.get(ii), data[ii].first);
+    }
+    BOOST_CHECK_EQUAL(keys.lowerBound(0, 4, -5), 1);
+    BOOST_CHECK_EQUAL(keys.lowerBound(0, 4, 1), 3);
+    BOOST_CHECK_EQUAL(keys.lowerBound(0, 3, 1), 3);
+}
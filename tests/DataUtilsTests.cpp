@@ -0,0 +1,54 @@
+/**
+ * @file DataUtilsTests.cpp
+ *
+ * @brief Tests of the training batch sampler
+ *
+ * @date 10/18/2026
+ */
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE DataUtilsTests
+
+#include <boost/test/unit_test.hpp>
+#include <set>
+#include "../src/utils/DataUtils.h"
+
+BOOST_AUTO_TEST_CASE(stratified_batches_are_in_range_and_unique) {
+    const size_t batchSize = 64;
+    const size_t datasetSize = 1000;
+    BatchSampler sampler(batchSize, datasetSize, 42);
+
+    for (int epoch = 0; epoch < 100; ++epoch) {
+        const auto &batch = sampler.nextBatch();
+        BOOST_REQUIRE_EQUAL(batch.size(), batchSize);
+
+        std::set<size_t> unique(batch.begin(), batch.end());
+        BOOST_CHECK_EQUAL(unique.size(), batchSize);
+        BOOST_CHECK(*unique.rbegin() < datasetSize);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(sampler_is_reproducible) {
+    BatchSampler first(32, 500, 7);
+    BatchSampler second(32, 500, 7);
+
+    for (int epoch = 0; epoch < 10; ++epoch) {
+        std::vector<size_t> firstBatch = first.nextBatch();
+        const auto &secondBatch = second.nextBatch();
+        BOOST_CHECK(firstBatch == secondBatch);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(full_pass_visits_every_index) {
+    const size_t batchSize = 10;
+    const size_t datasetSize = 100;
+    BatchSampler sampler(batchSize, datasetSize, 3, true);
+    BOOST_REQUIRE_EQUAL(sampler.batchesPerEpoch(), datasetSize / batchSize);
+
+    std::set<size_t> seen;
+    for (size_t ii = 0; ii < sampler.batchesPerEpoch(); ++ii) {
+        const auto &batch = sampler.nextBatch();
+        seen.insert(batch.begin(), batch.end());
+    }
+    BOOST_CHECK_EQUAL(seen.size(), datasetSize);
+}
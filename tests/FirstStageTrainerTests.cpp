@@ -0,0 +1,84 @@
+/**
+ * @file FirstStageTrainerTests.cpp
+ *
+ * @brief Tests of multithreaded first stage training
+ *
+ * @date 10/19/2026
+ */
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE FirstStageTrainerTests
+
+#include <boost/test/unit_test.hpp>
+#include "../src/FirstStageTrainer.h"
+#include "../src/utils/DataGenerators.h"
+
+namespace {
+    const size_t datasetSize = 20000;
+
+    /**
+     * @brief Train on lognormal keys and return the mean position error of the result
+     */
+    double trainAndMeasure(const ParallelTrainingParameters &parallelParams, size_t &numIterations) {
+        auto values = getIntegerLognormals<long, datasetSize>(1e7);
+        std::vector<float> keys(values.begin(), values.end());
+        std::vector<float> positions(datasetSize);
+        for (size_t ii = 0; ii < datasetSize; ++ii) {
+            positions[ii] = static_cast<float>(ii);
+        }
+
+        NetworkParameters networkParams;
+        networkParams.batchSize = 64;
+        networkParams.maxNumEpochs = 20000;
+        networkParams.learningRate = 0.01;
+        networkParams.numNeurons = 8;
+
+        FirstStageTrainer trainer(networkParams, parallelParams);
+        FirstStageWeights weights = trainer.train(keys.data(), positions.data(), datasetSize, datasetSize);
+        BOOST_CHECK_EQUAL(weights.numNeurons(), 8);
+        numIterations = trainer.numIterations();
+
+        double errorSum = 0;
+        for (size_t ii = 0; ii < datasetSize; ++ii) {
+            errorSum += std::abs(weights.predict(keys[ii]) * datasetSize - positions[ii]);
+        }
+        return errorSum / datasetSize;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(first_stage_trainer_synchronous) {
+    ParallelTrainingParameters parallelParams;
+    parallelParams.numThreads = 3;
+
+    size_t numIterations = 0;
+    double meanError = trainAndMeasure(parallelParams, numIterations);
+    BOOST_CHECK_LT(meanError, datasetSize * 0.02);
+    // Converged well before the iteration budget
+    BOOST_CHECK_LT(numIterations, 20000);
+}
+
+BOOST_AUTO_TEST_CASE(first_stage_trainer_hogwild) {
+    ParallelTrainingParameters parallelParams;
+    parallelParams.numThreads = 3;
+    parallelParams.hogwild = true;
+
+    size_t numIterations = 0;
+    double meanError = trainAndMeasure(parallelParams, numIterations);
+    BOOST_CHECK_LT(meanError, datasetSize * 0.02);
+}
+
+BOOST_AUTO_TEST_CASE(first_stage_trainer_without_samples) {
+    NetworkParameters networkParams;
+    networkParams.batchSize = 64;
+    networkParams.maxNumEpochs = 100;
+    networkParams.learningRate = 0.01;
+    networkParams.numNeurons = 8;
+    ParallelTrainingParameters parallelParams;
+    parallelParams.numThreads = 2;
+
+    FirstStageTrainer trainer(networkParams, parallelParams);
+    FirstStageWeights weights = trainer.train(nullptr, nullptr, 0, 0);
+    BOOST_CHECK_EQUAL(weights.numNeurons(), 8);
+    BOOST_CHECK_EQUAL(trainer.numIterations(), 0);
+    BOOST_CHECK_EQUAL(weights.predict(1000.0f), 0.0f);
+}
@@ -0,0 +1,123 @@
+/**
+ * @file GappedArrayTests.cpp
+ *
+ * @brief Tests of the gapped array leaves of the second stage
+ *
+ * @date 10/18/2026
+ */
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE GappedArrayTests
+
+#include <boost/test/unit_test.hpp>
+#include <map>
+#include <random>
+#include "../src/GappedArray.h"
+#include "../src/utils/DataGenerators.h"
+
+BOOST_AUTO_TEST_CASE(gapped_array_bulk_load_and_find) {
+    const size_t datasetSize = 10000;
+    auto values = getIntegerLognormals<long, datasetSize>(1e7);
+
+    std::vector<std::pair<long, long>> data;
+    for (auto value : values) {
+        data.push_back({value, value * 2});
+    }
+
+    GappedArray<long, long> leaf;
+    leaf.bulkLoad(data);
+    BOOST_CHECK_EQUAL(leaf.size(), datasetSize);
+    BOOST_CHECK(leaf.capacity() > datasetSize);
+
+    for (auto value : values) {
+        auto result = leaf.find(value);
+        BOOST_REQUIRE(result);
+        BOOST_CHECK_EQUAL(result.get().second, value * 2);
+    }
+    BOOST_CHECK(!leaf.find(-1));
+    BOOST_CHECK(!leaf.find(static_cast<long>(2e7)));
+}
+
+BOOST_AUTO_TEST_CASE(gapped_array_inserts) {
+    GappedLeafParameters params;
+    GappedArray<int, int> leaf(params);
+
+    std::map<int, int> reference;
+    std::mt19937 rng(0);
+    std::uniform_int_distribution<int> distribution(0, 1000000);
+
+    for (int ii = 0; ii < 20000; ++ii) {
+        int key = distribution(rng);
+        if (reference.count(key)) {
+            continue;
+        }
+        reference[key] = ii;
+        leaf.insert(key, ii);
+        BOOST_REQUIRE(leaf.size() <= params.maxDensity * leaf.capacity());
+    }
+
+    BOOST_CHECK_EQUAL(leaf.size(), reference.size());
+    for (const auto &pair : reference) {
+        auto result = leaf.find(pair.first);
+        BOOST_REQUIRE(result);
+        BOOST_CHECK_EQUAL(result.get().second, pair.second);
+    }
+
+    // Collect returns keys in sorted order
+    std::vector<std::pair<int, int>> collected;
+    leaf.collect(collected);
+    std::vector<std::pair<int, int>> expected(reference.begin(), reference.end());
+    BOOST_CHECK(collected == expected);
+}
+
+/**
+ * @brief Load keys 0, 1000, ..., 999000 into a leaf, which its linear model fits exactly
+ */
+GappedArray<long, long> getEvenlySpacedLeaf(const GappedLeafParameters &params) {
+    std::vector<std::pair<long, long>> data;
+    for (long ii = 0; ii < 1000; ++ii) {
+        data.push_back({ii * 1000, ii});
+    }
+    GappedArray<long, long> leaf(params);
+    leaf.bulkLoad(data);
+    return leaf;
+}
+
+BOOST_AUTO_TEST_CASE(gapped_array_refits_after_mispredicted_inserts) {
+    GappedLeafParameters params;
+    GappedArray<long, long> leaf = getEvenlySpacedLeaf(params);
+    const size_t initialCapacity = leaf.capacity();
+    // Only outgrowing maxDensity would resize the leaf without a refit
+    const size_t densityInserts = static_cast<size_t>(params.maxDensity * initialCapacity) - leaf.size();
+
+    // A cluster between two keys all predicts the same slot, and pushes its neighbours further and further away
+    size_t numInserts = 0;
+    while (leaf.capacity() == initialCapacity) {
+        ++numInserts;
+        leaf.insert(500000 + static_cast<long>(numInserts), -1);
+    }
+
+    // The refit counts mispredictions against inserts since the last rebuild, not against all 1000 keys
+    BOOST_CHECK(numInserts >= params.minRefitInserts);
+    BOOST_CHECK(numInserts < densityInserts);
+    BOOST_CHECK_EQUAL(leaf.capacity(), static_cast<size_t>(leaf.size() / params.initialDensity) + 1);
+
+    for (size_t ii = 1; ii <= numInserts; ++ii) {
+        BOOST_REQUIRE(leaf.find(500000 + static_cast<long>(ii)));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(gapped_array_keeps_model_for_predicted_inserts) {
+    GappedLeafParameters params;
+    GappedArray<long, long> leaf = getEvenlySpacedLeaf(params);
+    const size_t initialCapacity = leaf.capacity();
+    const size_t densityInserts = static_cast<size_t>(params.maxDensity * initialCapacity) - leaf.size();
+
+    // Spread out inserts land next to their predicted slot, so only density forces a rebuild
+    for (size_t ii = 0; ii < densityInserts; ++ii) {
+        leaf.insert(static_cast<long>((ii * 7 % 1000) * 1000 + 500), -1);
+        BOOST_REQUIRE_EQUAL(leaf.capacity(), initialCapacity);
+    }
+    leaf.insert(999999, -1);
+    BOOST_CHECK(leaf.capacity() > initialCapacity);
+}
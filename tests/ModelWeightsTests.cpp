@@ -0,0 +1,174 @@
+/**
+ * @file ModelWeightsTests.cpp
+ *
+ * @brief Tests of the weight file shared with the PyTorch notebook
+ *
+ * @date 10/19/2026
+ */
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE ModelWeightsTests
+
+#include <boost/test/unit_test.hpp>
+#include <cstdio>
+#include <sstream>
+#include "../src/utils/ModelWeights.h"
+
+namespace {
+    const std::string path = "model_weights_test.weights";
+
+    FirstStageWeights getFirstStage() {
+        FirstStageWeights weights;
+        weights.hiddenWeight = {1.0f, 0.5f, -2.25f};
+        weights.hiddenBias = {0.0f, -1000.0f, 3.0e6f};
+        weights.outputWeight = {1.0e-7f, 3.3333333e-8f, -1.2345678e-9f};
+        weights.outputBias = 0.125f;
+        return weights;
+    }
+
+    std::vector<LinearModelWeights> getSecondStage() {
+        std::vector<LinearModelWeights> weights(4);
+        for (size_t ii = 0; ii < weights.size(); ++ii) {
+            weights[ii].weight = 1.0f / (3.0f + ii);
+            weights[ii].bias = -0.1f * ii;
+        }
+        return weights;
+    }
+
+    void writeFile(const std::string &contents) {
+        std::ofstream file(path);
+        file << contents;
+    }
+
+    std::string readFile() {
+        std::ifstream file(path);
+        std::stringstream contents;
+        contents << file.rdbuf();
+        return contents.str();
+    }
+
+    /**
+     * @brief Load the weight file over known weights, expecting it to fail and leave them untouched
+     */
+    void checkLoadFails() {
+        FirstStageWeights firstStage = getFirstStage();
+        std::vector<LinearModelWeights> secondStage = getSecondStage();
+        BOOST_CHECK(!loadModelWeights(path, firstStage, secondStage));
+
+        FirstStageWeights expectedFirstStage = getFirstStage();
+        BOOST_CHECK(firstStage.hiddenWeight == expectedFirstStage.hiddenWeight);
+        BOOST_CHECK(firstStage.hiddenBias == expectedFirstStage.hiddenBias);
+        BOOST_CHECK(firstStage.outputWeight == expectedFirstStage.outputWeight);
+        BOOST_CHECK_EQUAL(firstStage.outputBias, expectedFirstStage.outputBias);
+        BOOST_REQUIRE_EQUAL(secondStage.size(), getSecondStage().size());
+        for (size_t ii = 0; ii < secondStage.size(); ++ii) {
+            BOOST_CHECK_EQUAL(secondStage[ii].weight, getSecondStage()[ii].weight);
+            BOOST_CHECK_EQUAL(secondStage[ii].bias, getSecondStage()[ii].bias);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(model_weights_round_trip) {
+    BOOST_REQUIRE(saveModelWeights(path, getFirstStage(), getSecondStage()));
+
+    FirstStageWeights firstStage;
+    std::vector<LinearModelWeights> secondStage;
+    BOOST_REQUIRE(loadModelWeights(path, firstStage, secondStage));
+
+    // 9 significant digits make every float round trip exactly
+    FirstStageWeights expectedFirstStage = getFirstStage();
+    BOOST_CHECK(firstStage.hiddenWeight == expectedFirstStage.hiddenWeight);
+    BOOST_CHECK(firstStage.hiddenBias == expectedFirstStage.hiddenBias);
+    BOOST_CHECK(firstStage.outputWeight == expectedFirstStage.outputWeight);
+    BOOST_CHECK_EQUAL(firstStage.outputBias, expectedFirstStage.outputBias);
+    BOOST_REQUIRE_EQUAL(secondStage.size(), getSecondStage().size());
+    for (size_t ii = 0; ii < secondStage.size(); ++ii) {
+        BOOST_CHECK_EQUAL(secondStage[ii].weight, getSecondStage()[ii].weight);
+        BOOST_CHECK_EQUAL(secondStage[ii].bias, getSecondStage()[ii].bias);
+    }
+    BOOST_CHECK_EQUAL(firstStage.predict(1234.0f), expectedFirstStage.predict(1234.0f));
+    std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(model_weights_reject_bad_header) {
+    BOOST_REQUIRE(saveModelWeights(path, getFirstStage(), getSecondStage()));
+    const std::string contents = readFile();
+    const std::string header = "learned_indices_weights 1";
+    BOOST_REQUIRE_EQUAL(contents.compare(0, header.size(), header), 0);
+
+    writeFile("learned_indices_weightz 1" + contents.substr(header.size()));
+    checkLoadFails();
+    writeFile("learned_indices_weights 2" + contents.substr(header.size()));
+    checkLoadFails();
+    writeFile("");
+    checkLoadFails();
+
+    std::remove(path.c_str());
+    checkLoadFails();
+}
+
+BOOST_AUTO_TEST_CASE(model_weights_reject_truncated_file) {
+    BOOST_REQUIRE(saveModelWeights(path, getFirstStage(), getSecondStage()));
+    const std::string contents = readFile();
+
+    // Cut the file after every line but the last, and in the middle of every line
+    size_t lineEnd = contents.find('\n');
+    while (lineEnd + 1 < contents.size()) {
+        size_t lineStart = contents.rfind('\n', lineEnd - 1);
+        lineStart = lineStart == std::string::npos ? 0 : lineStart + 1;
+
+        writeFile(contents.substr(0, lineEnd + 1));
+        checkLoadFails();
+        writeFile(contents.substr(0, lineStart + (lineEnd - lineStart) / 2));
+        checkLoadFails();
+        lineEnd = contents.find('\n', lineEnd + 1);
+    }
+    std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(model_weights_reject_shape_mismatch) {
+    const std::string firstStageLines =
+            "hidden_weight 1 2 3\nhidden_bias 1 2 3\noutput_weight 1 2 3\noutput_bias 0.5\n";
+    const std::string secondStageLines = "second_stage 2\n0.1 0.2\n0.3 0.4\n";
+
+    // Sanity check the well formed file loads
+    writeFile("learned_indices_weights 1\nfirst_stage 3\n" + firstStageLines + secondStageLines);
+    FirstStageWeights firstStage;
+    std::vector<LinearModelWeights> secondStage;
+    BOOST_REQUIRE(loadModelWeights(path, firstStage, secondStage));
+    BOOST_CHECK_EQUAL(firstStage.numNeurons(), 3);
+    BOOST_CHECK_EQUAL(secondStage.size(), 2);
+
+    // Layer sizes that disagree with the values that follow them
+    writeFile("learned_indices_weights 1\nfirst_stage 2\n" + firstStageLines + secondStageLines);
+    checkLoadFails();
+    writeFile("learned_indices_weights 1\nfirst_stage 4\n" + firstStageLines + secondStageLines);
+    checkLoadFails();
+    writeFile("learned_indices_weights 1\nfirst_stage 3\n"
+              "hidden_weight 1 2 3\nhidden_bias 1 2\noutput_weight 1 2 3\noutput_bias 0.5\n" + secondStageLines);
+    checkLoadFails();
+    writeFile("learned_indices_weights 1\nfirst_stage 3\n" + firstStageLines + "second_stage 3\n0.1 0.2\n0.3 0.4\n");
+    checkLoadFails();
+    writeFile("learned_indices_weights 1\nfirst_stage 3\n" + firstStageLines + "second_stage 1\n0.1 0.2\n0.3 0.4\n");
+    checkLoadFails();
+    writeFile("learned_indices_weights 1\nfirst_stage 3\n" + firstStageLines + "second_stage 2\n0.1 0.2\n0.3\n");
+    checkLoadFails();
+    std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(model_weights_reject_sizes_larger_than_the_file) {
+    const std::string firstStageLines =
+            "hidden_weight 1 2 3\nhidden_bias 1 2 3\noutput_weight 1 2 3\noutput_bias 0.5\n";
+    const std::string secondStageLines = "second_stage 2\n0.1 0.2\n0.3 0.4\n";
+
+    // Corrupt sizes must be rejected as a bad file, not attempted as an allocation
+    writeFile("learned_indices_weights 1\nfirst_stage 1000000000000000000\n" + firstStageLines + secondStageLines);
+    checkLoadFails();
+    writeFile("learned_indices_weights 1\nfirst_stage 18446744073709551615\n" + firstStageLines + secondStageLines);
+    checkLoadFails();
+    writeFile("learned_indices_weights 1\nfirst_stage 3\n" + firstStageLines + "second_stage 1000000000000000000\n0.1 0.2\n");
+    checkLoadFails();
+    writeFile("learned_indices_weights 1\nfirst_stage 3\n" + firstStageLines + "second_stage 3\n0.1 0.2\n0.3 0.4\n");
+    checkLoadFails();
+    std::remove(path.c_str());
+}
@@ -0,0 +1,92 @@
+/**
+ * @file NumaReplicatedIndexTests.cpp
+ *
+ * @brief Tests of the NUMA replicated static index, on emulated nodes
+ *
+ * @date 10/19/2026
+ */
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE NumaReplicatedIndexTests
+
+#include <boost/test/unit_test.hpp>
+#include <atomic>
+#include "../src/NumaReplicatedIndex.h"
+#include "../src/utils/DataGenerators.h"
+
+namespace {
+    const size_t datasetSize = 10000;
+
+    typedef NumaReplicatedIndex<long, long, 2, 64> Index;
+
+    std::unique_ptr<Index::IndexType> makeIndex(std::vector<std::pair<long, long>> &data) {
+        auto values = getIntegerLognormals<long, datasetSize>(1e7);
+        for (auto value : values) {
+            data.push_back({value, value * 2});
+        }
+
+        FirstStageWeights firstStage;
+        firstStage.hiddenWeight = {1.0f, 1.0f};
+        firstStage.hiddenBias = {0.0f, -static_cast<float>(data.back().first) / 2};
+        firstStage.outputWeight = {0.5f / data.back().first, 0.5f / data.back().first};
+
+        std::unique_ptr<Index::IndexType> index(new Index::IndexType());
+        BOOST_REQUIRE(index->build(data, firstStage));
+        return index;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(numa_index_finds_every_key_from_every_node) {
+    std::vector<std::pair<long, long>> data;
+    auto staticIndex = makeIndex(data);
+
+    for (auto placement : {NumaDataPlacement::Replicate, NumaDataPlacement::Interleave, NumaDataPlacement::Partition}) {
+        NumaParameters params;
+        params.numNodes = 3;
+        params.dataPlacement = placement;
+
+        Index index(params);
+        index.build(*staticIndex);
+        BOOST_REQUIRE_EQUAL(index.topology().numNodes(), 3);
+        BOOST_CHECK_EQUAL(index.size(), data.size());
+
+        std::atomic<size_t> numWrong(0);
+        index.runWorkers(2, [&](size_t node, size_t) {
+            for (const auto &pair : data) {
+                auto result = index.find(pair.first, node);
+                if (!result || result.get().second != pair.second) {
+                    numWrong++;
+                }
+            }
+            if (index.find(-1, node) || index.find(data.back().first + 1, node)) {
+                numWrong++;
+            }
+        });
+        BOOST_CHECK_EQUAL(numWrong.load(), 0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(numa_index_partitions_keys_by_range) {
+    std::vector<std::pair<long, long>> data;
+    auto staticIndex = makeIndex(data);
+
+    NumaParameters params;
+    params.numNodes = 4;
+    params.dataPlacement = NumaDataPlacement::Partition;
+    Index index(params);
+    index.build(*staticIndex);
+
+    // Owners never decrease along the sorted keys, and every node owns some
+    size_t previousOwner = 0;
+    std::vector<size_t> keysPerNode(4, 0);
+    for (const auto &pair : data) {
+        size_t owner = index.ownerNode(pair.first);
+        BOOST_REQUIRE_GE(owner, previousOwner);
+        BOOST_REQUIRE_LT(owner, 4);
+        keysPerNode[owner]++;
+        previousOwner = owner;
+    }
+    for (size_t count : keysPerNode) {
+        BOOST_CHECK_GT(count, 0);
+    }
+}
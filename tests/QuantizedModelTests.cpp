@@ -0,0 +1,76 @@
+/**
+ * @file QuantizedModelTests.cpp
+ *
+ * @brief Tests of the fixed point models used for quantized inference
+ *
+ * @date 10/19/2026
+ */
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE QuantizedModelTests
+
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <limits>
+#include <random>
+#include "../src/utils/QuantizedModel.h"
+
+BOOST_AUTO_TEST_CASE(quantized_linear_model_matches_float) {
+    std::mt19937_64 rng(0);
+
+    // A node of 1000 positions spread over a narrow int range
+    const int minKey = -50000, maxKey = 150000;
+    const double slope = 1000.0 / (maxKey - minKey);
+    auto narrowModel = QuantizedLinearModel<int>::fit(slope, 123456.0, minKey, maxKey);
+    for (int key = minKey; key <= maxKey; key += 7) {
+        double expected = 123456.0 + slope * (static_cast<double>(key) - minKey);
+        BOOST_REQUIRE_LE(std::abs(narrowModel.predict(key) - std::floor(expected)), 1);
+    }
+    // Keys outside the range are clamped to its ends
+    BOOST_CHECK_EQUAL(narrowModel.predict(std::numeric_limits<int>::min()), narrowModel.predict(minKey));
+    BOOST_CHECK_EQUAL(narrowModel.predict(std::numeric_limits<int>::max()), narrowModel.predict(maxKey));
+
+    // The whole int64 range, so deltas need shifting into 32 bits
+    const long wideMin = std::numeric_limits<long>::min(), wideMax = std::numeric_limits<long>::max();
+    const double wideSlope = 1e9 / std::ldexp(1.0, 64);
+    auto wideModel = QuantizedLinearModel<long>::fit(wideSlope, 0, wideMin, wideMax);
+    BOOST_CHECK_GT(wideModel.keyShift, 0);
+    for (size_t trial = 0; trial < 10000; ++trial) {
+        long key = static_cast<long>(rng());
+        double expected = wideSlope * (static_cast<double>(key) - static_cast<double>(wideMin));
+        BOOST_REQUIRE_LE(std::abs(wideModel.predict(key) - std::floor(expected)), 1);
+    }
+
+    // Garbage from an untrained model still evaluates without overflow
+    auto garbageModel = QuantizedLinearModel<long>::fit(std::nan(""), 1e300, wideMin, wideMax);
+    BOOST_CHECK_EQUAL(garbageModel.predict(0), garbageModel.predict(wideMax));
+}
+
+BOOST_AUTO_TEST_CASE(quantized_first_stage_matches_network) {
+    std::mt19937 rng(0);
+    std::normal_distribution<float> distribution(0, 1);
+
+    // Hinges spread over the key range, like a trained first stage
+    const long minKey = -1000000, maxKey = 9000000;
+    FirstStageWeights weights;
+    for (int jj = 0; jj < 8; ++jj) {
+        float scale = 1.0f / (maxKey - minKey);
+        weights.hiddenWeight.push_back((jj % 2 ? 1 : -1) * scale);
+        weights.hiddenBias.push_back(-weights.hiddenWeight.back() * (minKey + jj * (maxKey - minKey) / 8.0f));
+        weights.outputWeight.push_back(distribution(rng));
+    }
+    weights.outputBias = 0.5;
+
+    const double outputScale = 1024;
+    auto model = QuantizedPiecewiseLinearModel<long>::fromFirstStage(weights, outputScale, minKey, maxKey);
+    BOOST_CHECK_EQUAL(model.segments.size(), model.breakpoints.size() + 1);
+
+    for (long key = minKey; key <= maxKey; key += 997) {
+        double expected = weights.outputBias;
+        for (size_t jj = 0; jj < weights.numNeurons(); ++jj) {
+            expected += weights.outputWeight[jj] *
+                        std::max(0.0, static_cast<double>(weights.hiddenWeight[jj]) * key + weights.hiddenBias[jj]);
+        }
+        BOOST_REQUIRE_LE(std::abs(model.predict(key) - std::floor(expected * outputScale)), 1);
+    }
+}
@@ -0,0 +1,530 @@
+/**
+ * @file RecursiveModelIndexTests.cpp
+ *
+ * @breif Lookups of the Recursive Model Index checked against the data it was built from, for each feature
+ *
+ * @date 10/19/2026
+ * @author Ben Caine
+ */
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE RecursiveModelIndexTests
+
+#include <boost/test/unit_test.hpp>
+#include <set>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <fstream>
+#include <algorithm>
+#include "../src/RecursiveModelIndex.h"
+
+typedef RecursiveModelIndex<long, long, 32> Index;
+
+/**
+ * @brief Small, quick to train first stage parameters. Lookups are exact however well the models fit
+ */
+NetworkParameters getFirstStageParams() {
+    NetworkParameters params;
+    params.batchSize = 64;
+    params.maxNumEpochs = 200;
+    params.learningRate = 0.01;
+    params.numNeurons = 8;
+    return params;
+}
+
+NetworkParameters getSecondStageParams() {
+    NetworkParameters params;
+    params.batchSize = 32;
+    params.maxNumEpochs = 50;
+    params.learningRate = 0.01;
+    params.numNeurons = 1;
+    return params;
+}
+
+/**
+ * @brief Distinct even keys in random order, so every odd key is a miss
+ */
+std::vector<long> getEvenKeys(size_t numKeys, unsigned int seed) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<long> distribution(0, 5000000);
+    std::set<long> seen;
+    std::vector<long> keys;
+    while (keys.size() < numKeys) {
+        long key = distribution(rng) * 2;
+        if (seen.insert(key).second) {
+            keys.push_back(key);
+        }
+    }
+    return keys;
+}
+
+/**
+ * @brief Check an index finds every key with its value (key + 1), and none of the misses
+ */
+void checkLookups(Index &index, const std::vector<long> &keys, const std::vector<long> &misses) {
+    for (long key : keys) {
+        auto result = index.find(key);
+        BOOST_REQUIRE(result);
+        BOOST_REQUIRE_EQUAL(result.get().first, key);
+        BOOST_REQUIRE_EQUAL(result.get().second, key + 1);
+    }
+    for (long key : misses) {
+        BOOST_REQUIRE(!index.find(key));
+    }
+}
+
+/**
+ * @return Odd keys spread over and past the range of the even keys
+ */
+std::vector<long> getMisses() {
+    std::vector<long> misses;
+    for (long key = -1001; key < 10002000; key += 4002) {
+        misses.push_back(key);
+    }
+    return misses;
+}
+
+BOOST_AUTO_TEST_CASE(existence_filter_matches_unfiltered_lookups) {
+    auto keys = getEvenKeys(5000, 0);
+    auto misses = getMisses();
+
+    Index plain(getFirstStageParams(), getSecondStageParams());
+    Index filtered(getFirstStageParams(), getSecondStageParams());
+    filtered.enableExistenceFilter(ExistenceFilterParameters());
+    for (long key : keys) {
+        plain.insert(key, key + 1);
+        filtered.insert(key, key + 1);
+    }
+    plain.train();
+    filtered.train();
+
+    checkLookups(plain, keys, misses);
+    checkLookups(filtered, keys, misses);
+
+    // Inserts after training land in the overflow array, the filter has to let them through
+    auto newKeys = getEvenKeys(100, 1);
+    std::vector<long> allKeys = keys;
+    for (long key : newKeys) {
+        if (std::find(keys.begin(), keys.end(), key) == keys.end()) {
+            filtered.insert(key, key + 1);
+            allKeys.push_back(key);
+        }
+    }
+    checkLookups(filtered, allKeys, misses);
+}
+
+BOOST_AUTO_TEST_CASE(existence_filter_covers_gapped_leaf_inserts) {
+    auto keys = getEvenKeys(5000, 2);
+    auto misses = getMisses();
+
+    Index index(getFirstStageParams(), getSecondStageParams());
+    index.enableExistenceFilter(ExistenceFilterParameters());
+    index.enableGappedLeaves(GappedLeafParameters());
+    for (long key : keys) {
+        index.insert(key, key + 1);
+    }
+    index.train();
+
+    // These go straight into the leaves. Keys past both ends of the trained range widen the filter's range check
+    std::vector<long> allKeys = keys;
+    for (long key : {-4L, 20000000L, 20000002L}) {
+        index.insert(key, key + 1);
+        allKeys.push_back(key);
+    }
+    for (long key : getEvenKeys(1000, 3)) {
+        if (std::find(allKeys.begin(), allKeys.end(), key) == allKeys.end()) {
+            index.insert(key, key + 1);
+            allKeys.push_back(key);
+        }
+    }
+    checkLookups(index, allKeys, misses);
+}
+
+BOOST_AUTO_TEST_CASE(write_ahead_log_bounded_and_recovered_with_gapped_leaves) {
+    const std::string logPath = "recursive_model_index_test.wal";
+    const std::string snapshotPath = "recursive_model_index_test.snapshot";
+    std::remove(logPath.c_str());
+    std::remove(snapshotPath.c_str());
+
+    WriteAheadLogParameters logParams;
+    logParams.logPath = logPath;
+    logParams.snapshotPath = snapshotPath;
+    logParams.syncBatchSize = 1;
+    logParams.maxLogRecords = 100;
+
+    auto keys = getEvenKeys(1250, 4);
+    {
+        Index index(getFirstStageParams(), getSecondStageParams());
+        index.enableGappedLeaves(GappedLeafParameters());
+        BOOST_REQUIRE(index.enableWriteAheadLog(logParams));
+        for (size_t ii = 0; ii < 1000; ++ii) {
+            index.insert(keys[ii], keys[ii] + 1);
+        }
+        index.train();
+
+        // Leaf inserts never retrain, so only the record limit keeps the log short
+        for (size_t ii = 1000; ii < keys.size(); ++ii) {
+            index.insert(keys[ii], keys[ii] + 1);
+        }
+    }
+
+    // 250 leaf inserts snapshot at 100 and 200 records, leaving 50 in the log (28 bytes each, after a 28 byte header)
+    std::ifstream log(logPath, std::ios::binary | std::ios::ate);
+    BOOST_CHECK_EQUAL(static_cast<size_t>(log.tellg()), 28 + 50 * 28);
+
+    Index recovered(getFirstStageParams(), getSecondStageParams());
+    recovered.enableGappedLeaves(GappedLeafParameters());
+    BOOST_REQUIRE(recovered.enableWriteAheadLog(logParams));
+    recovered.train();
+    checkLookups(recovered, keys, getMisses());
+
+    std::remove(logPath.c_str());
+    std::remove(snapshotPath.c_str());
+}
+
+/**
+ * @return Parallel training settings that train quickly on one thread, so the first stage can be exported
+ */
+ParallelTrainingParameters getParallelTrainingParams() {
+    ParallelTrainingParameters params;
+    params.numThreads = 1;
+    return params;
+}
+
+BOOST_AUTO_TEST_CASE(saved_models_load_into_an_equivalent_index) {
+    const std::string path = "recursive_model_index_test.weights";
+    auto keys = getEvenKeys(5000, 5);
+    auto misses = getMisses();
+
+    Index trained(getFirstStageParams(), getSecondStageParams());
+    for (long key : keys) {
+        trained.insert(key, key + 1);
+    }
+
+    // The network's parameters can't be read, only FirstStageTrainer's
+    trained.train();
+    BOOST_CHECK(!trained.saveModels(path));
+    trained.enableParallelTraining(getParallelTrainingParams());
+    trained.train();
+    BOOST_REQUIRE(trained.saveModels(path));
+
+    Index loaded(getFirstStageParams(), getSecondStageParams());
+    BOOST_REQUIRE(loaded.loadModels(path));
+    for (long key : keys) {
+        loaded.insert(key, key + 1);
+    }
+    loaded.train();
+
+    checkLookups(trained, keys, misses);
+    checkLookups(loaded, keys, misses);
+    for (long key : keys) {
+        BOOST_REQUIRE(trained.find(key) == loaded.find(key));
+    }
+
+    // Saving the loaded models gives the same file back
+    const std::string resavedPath = "recursive_model_index_test_resaved.weights";
+    BOOST_REQUIRE(loaded.saveModels(resavedPath));
+    FirstStageWeights firstStage, resavedFirstStage;
+    std::vector<LinearModelWeights> secondStage, resavedSecondStage;
+    BOOST_REQUIRE(loadModelWeights(path, firstStage, secondStage));
+    BOOST_REQUIRE(loadModelWeights(resavedPath, resavedFirstStage, resavedSecondStage));
+    BOOST_CHECK(firstStage.hiddenWeight == resavedFirstStage.hiddenWeight);
+    BOOST_REQUIRE_EQUAL(secondStage.size(), resavedSecondStage.size());
+    for (size_t ii = 0; ii < secondStage.size(); ++ii) {
+        BOOST_CHECK_EQUAL(secondStage[ii].weight, resavedSecondStage[ii].weight);
+        BOOST_CHECK_EQUAL(secondStage[ii].bias, resavedSecondStage[ii].bias);
+    }
+
+    std::remove(path.c_str());
+    std::remove(resavedPath.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(load_models_rejects_mismatched_file_and_keeps_index) {
+    const std::string path = "recursive_model_index_test.weights";
+    auto keys = getEvenKeys(2000, 6);
+    auto misses = getMisses();
+
+    Index index(getFirstStageParams(), getSecondStageParams());
+    for (long key : keys) {
+        index.insert(key, key + 1);
+    }
+    index.train();
+
+    // A file for a 16 node index, and a file with the right node count but a torn second stage
+    std::vector<LinearModelWeights> secondStage(16);
+    BOOST_REQUIRE(saveModelWeights(path, FirstStageWeights(), secondStage));
+    BOOST_CHECK(!index.loadModels(path));
+    {
+        std::ofstream file(path);
+        file << "learned_indices_weights 1\nfirst_stage 1\nhidden_weight 1\nhidden_bias 0\n"
+             << "output_weight 1e-7\noutput_bias 0\nsecond_stage 32\n0 0\n";
+    }
+    BOOST_CHECK(!index.loadModels(path));
+
+    // Still the index it was, and still training its own models
+    checkLookups(index, keys, misses);
+    index.train();
+    checkLookups(index, keys, misses);
+    BOOST_CHECK(!index.saveModels(path));
+    std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(load_models_into_a_trained_index) {
+    const std::string path = "recursive_model_index_test.weights";
+    auto keys = getEvenKeys(5000, 15);
+    auto misses = getMisses();
+
+    // Models of a different index, over different keys
+    Index source(getFirstStageParams(), getSecondStageParams());
+    source.enableParallelTraining(getParallelTrainingParams());
+    for (long key : getEvenKeys(5000, 16)) {
+        source.insert(key, key + 1);
+    }
+    source.train();
+    BOOST_REQUIRE(source.saveModels(path));
+
+    for (bool quantized : {false, true}) {
+        Index index(getFirstStageParams(), getSecondStageParams());
+        if (quantized) {
+            index.enableQuantizedInference();
+        }
+        for (long key : keys) {
+            index.insert(key, key + 1);
+        }
+        index.train();
+
+        // The loaded models wait for train(), the ones the bounds were computed for keep routing until then
+        BOOST_REQUIRE(index.loadModels(path));
+        checkLookups(index, keys, misses);
+        index.train();
+        checkLookups(index, keys, misses);
+    }
+    std::remove(path.c_str());
+}
+
+/**
+ * @brief Build an index over keys (value key + 1) with features switched on by configure(index) before training
+ */
+template <typename Configure>
+std::unique_ptr<Index> buildIndex(const std::vector<long> &keys, Configure configure) {
+    std::unique_ptr<Index> index(new Index(getFirstStageParams(), getSecondStageParams()));
+    configure(*index);
+    for (long key : keys) {
+        index->insert(key, key + 1);
+    }
+    index->train();
+    return index;
+}
+
+/**
+ * @brief Check two indexes agree on every key and miss, and that the first one finds exactly the keys
+ */
+void checkSameLookups(Index &expected, Index &actual, const std::vector<long> &keys, const std::vector<long> &misses) {
+    checkLookups(expected, keys, misses);
+    for (long key : keys) {
+        BOOST_REQUIRE(expected.find(key) == actual.find(key));
+    }
+    for (long key : misses) {
+        BOOST_REQUIRE(expected.find(key) == actual.find(key));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(find_batch_matches_find) {
+    auto keys = getEvenKeys(5000, 7);
+    auto misses = getMisses();
+    auto index = buildIndex(keys, [](Index &) {});
+
+    // Some keys are in the overflow array rather than the trained data
+    auto newKeys = getEvenKeys(50, 8);
+    for (long key : newKeys) {
+        if (std::find(keys.begin(), keys.end(), key) == keys.end()) {
+            index->insert(key, key + 1);
+            keys.push_back(key);
+        }
+    }
+
+    std::vector<long> queries = keys;
+    queries.insert(queries.end(), misses.begin(), misses.end());
+    std::shuffle(queries.begin(), queries.end(), std::mt19937(9));
+
+    for (size_t numInFlight : {1, 4, 16, 64}) {
+        std::vector<boost::optional<std::pair<long, long>>> results;
+        index->findBatch(queries, results, numInFlight);
+        BOOST_REQUIRE_EQUAL(results.size(), queries.size());
+        for (size_t ii = 0; ii < queries.size(); ++ii) {
+            BOOST_REQUIRE(results[ii] == index->find(queries[ii]));
+        }
+    }
+    checkLookups(*index, keys, misses);
+}
+
+BOOST_AUTO_TEST_CASE(compressed_keys_match_plain_lookups) {
+    auto keys = getEvenKeys(5000, 10);
+    auto misses = getMisses();
+    auto plain = buildIndex(keys, [](Index &) {});
+    auto compressed = buildIndex(keys, [](Index &index) {
+        index.enableCompressedKeys();
+    });
+    checkSameLookups(*plain, *compressed, keys, misses);
+
+    std::vector<boost::optional<std::pair<long, long>>> results;
+    compressed->findBatch(keys, results);
+    for (size_t ii = 0; ii < keys.size(); ++ii) {
+        BOOST_REQUIRE(results[ii] && results[ii].get().second == keys[ii] + 1);
+    }
+
+    // Retraining decompresses, merges the overflow array and compresses again
+    long newKey = 10000002;
+    compressed->insert(newKey, newKey + 1);
+    compressed->train();
+    keys.push_back(newKey);
+    checkLookups(*compressed, keys, misses);
+}
+
+BOOST_AUTO_TEST_CASE(compressed_find_batch_searches_blocks) {
+    const std::string path = "recursive_model_index_compressed_test.weights";
+    auto keys = getEvenKeys(20000, 17);
+    auto misses = getMisses();
+
+    // Deliberately loose models and no trees, so search windows span many blocks of compressed keys
+    FirstStageWeights firstStage;
+    firstStage.hiddenWeight = {1.0f};
+    firstStage.hiddenBias = {0.0f};
+    firstStage.outputWeight = {1.0e-7f};
+    std::vector<LinearModelWeights> secondStage(32);
+    for (size_t ii = 0; ii < secondStage.size(); ++ii) {
+        secondStage[ii].weight = 0.9e-7f;
+        secondStage[ii].bias = 0.05f;
+    }
+    BOOST_REQUIRE(saveModelWeights(path, firstStage, secondStage));
+
+    Index index(getFirstStageParams(), getSecondStageParams(), 1 << 20, 1 << 20);
+    BOOST_REQUIRE(index.loadModels(path));
+    index.enableCompressedKeys();
+    for (long key : keys) {
+        index.insert(key, key + 1);
+    }
+    index.train();
+    checkLookups(index, keys, misses);
+
+    std::vector<long> queries = keys;
+    queries.insert(queries.end(), misses.begin(), misses.end());
+    for (long key : keys) {
+        queries.push_back(key + 1);
+    }
+    std::shuffle(queries.begin(), queries.end(), std::mt19937(18));
+    for (size_t numInFlight : {1, 16}) {
+        std::vector<boost::optional<std::pair<long, long>>> results;
+        index.findBatch(queries, results, numInFlight);
+        BOOST_REQUIRE_EQUAL(results.size(), queries.size());
+        for (size_t ii = 0; ii < queries.size(); ++ii) {
+            BOOST_REQUIRE(results[ii] == index.find(queries[ii]));
+        }
+    }
+    std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(quantized_inference_matches_plain_lookups) {
+    auto keys = getEvenKeys(5000, 11);
+    auto misses = getMisses();
+    auto plain = buildIndex(keys, [](Index &) {});
+    auto quantized = buildIndex(keys, [](Index &index) {
+        index.enableQuantizedInference();
+    });
+    checkSameLookups(*plain, *quantized, keys, misses);
+
+    std::vector<boost::optional<std::pair<long, long>>> results;
+    quantized->findBatch(misses, results);
+    for (const auto &result : results) {
+        BOOST_REQUIRE(!result);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(sampled_build_matches_full_build) {
+    auto keys = getEvenKeys(5000, 12);
+    auto misses = getMisses();
+    auto full = buildIndex(keys, [](Index &) {});
+    auto sampled = buildIndex(keys, [](Index &index) {
+        SampledBuildParameters params;
+        params.sampleFraction = 0.1;
+        params.minSampleSize = 100;
+        index.enableSampledBuild(params);
+    });
+    checkSameLookups(*full, *sampled, keys, misses);
+}
+
+BOOST_AUTO_TEST_CASE(gapped_leaf_inserts_are_found) {
+    auto keys = getEvenKeys(6000, 13);
+    auto misses = getMisses();
+    std::vector<long> initialKeys(keys.begin(), keys.begin() + 3000);
+    auto index = buildIndex(initialKeys, [](Index &index) {
+        // Small leaves, so inserts split some of them
+        GappedLeafParameters params;
+        params.maxLeafSize = 256;
+        index.enableGappedLeaves(params);
+    });
+
+    // As many inserts again as were trained on, so leaves expand and split along the way
+    for (size_t ii = 3000; ii < keys.size(); ++ii) {
+        index->insert(keys[ii], keys[ii] + 1);
+    }
+    checkLookups(*index, keys, misses);
+
+    // Retraining takes the data back out of the leaves
+    index->train();
+    checkLookups(*index, keys, misses);
+}
+
+BOOST_AUTO_TEST_CASE(write_ahead_log_replays_inserts_after_a_crash) {
+    const std::string logPath = "recursive_model_index_replay_test.wal";
+    const std::string snapshotPath = "recursive_model_index_replay_test.snapshot";
+    std::remove(logPath.c_str());
+    std::remove(snapshotPath.c_str());
+
+    WriteAheadLogParameters logParams;
+    logParams.logPath = logPath;
+    logParams.snapshotPath = snapshotPath;
+    logParams.syncBatchSize = 8;
+
+    auto keys = getEvenKeys(3000, 14);
+    {
+        Index index(getFirstStageParams(), getSecondStageParams());
+        BOOST_REQUIRE(index.enableWriteAheadLog(logParams));
+        for (size_t ii = 0; ii < 2000; ++ii) {
+            index.insert(keys[ii], keys[ii] + 1);
+        }
+        index.train();
+
+        // Only in the log and the overflow array when we "crash"
+        for (size_t ii = 2000; ii < keys.size(); ++ii) {
+            index.insert(keys[ii], keys[ii] + 1);
+        }
+        BOOST_REQUIRE(index.syncWriteAheadLog());
+    }
+
+    Index recovered(getFirstStageParams(), getSecondStageParams());
+    BOOST_REQUIRE(recovered.enableWriteAheadLog(logParams));
+    recovered.train();
+    checkLookups(recovered, keys, getMisses());
+
+    std::remove(logPath.c_str());
+    std::remove(snapshotPath.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(floating_point_keys) {
+    RecursiveModelIndex<double, long, 8> index(getFirstStageParams(), getSecondStageParams());
+    index.enableExistenceFilter(ExistenceFilterParameters());
+    for (long ii = 0; ii < 1000; ++ii) {
+        index.insert(ii * 0.5, ii);
+    }
+    index.train();
+
+    for (long ii = 0; ii < 1000; ++ii) {
+        auto result = index.find(ii * 0.5);
+        BOOST_REQUIRE(result);
+        BOOST_REQUIRE_EQUAL(result.get().second, ii);
+    }
+    BOOST_CHECK(!index.find(0.25));
+    BOOST_CHECK(!index.find(-1.0));
+}
@@ -0,0 +1,91 @@
+/**
+ * @file StaticRecursiveModelIndexTests.cpp
+ *
+ * @brief Tests of the compile time specialized recursive model index
+ *
+ * @date 10/18/2026
+ */
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE StaticRecursiveModelIndexTests
+
+#include <boost/test/unit_test.hpp>
+#include <random>
+#include "../src/StaticRecursiveModelIndex.h"
+#include "../src/utils/DataGenerators.h"
+
+namespace {
+    const size_t datasetSize = 10000;
+
+    std::vector<std::pair<long, long>> makeData() {
+        auto values = getIntegerLognormals<long, datasetSize>(1e7);
+        std::vector<std::pair<long, long>> data;
+        for (auto value : values) {
+            data.push_back({value, value * 2});
+        }
+        return data;
+    }
+
+    // A poor first stage (a ramp over the key range), so nodes get uneven and error bounds matter
+    FirstStageWeights makeFirstStage(const std::vector<std::pair<long, long>> &data) {
+        FirstStageWeights firstStage;
+        firstStage.hiddenWeight = {1.0f, 1.0f};
+        firstStage.hiddenBias = {0.0f, -static_cast<float>(data.back().first) / 2};
+        firstStage.outputWeight = {0.5f / data.back().first, 0.5f / data.back().first};
+        return firstStage;
+    }
+
+    template <typename Index>
+    void checkAllFound(const Index &index, const std::vector<std::pair<long, long>> &data) {
+        for (const auto &pair : data) {
+            auto result = index.find(pair.first);
+            BOOST_REQUIRE(result);
+            BOOST_CHECK_EQUAL(result.get().second, pair.second);
+        }
+        BOOST_CHECK(!index.find(-1));
+        BOOST_CHECK(!index.find(data.back().first + 1));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(static_index_finds_every_key) {
+    auto data = makeData();
+    auto firstStage = makeFirstStage(data);
+
+    std::unique_ptr<StaticRecursiveModelIndex<long, long, 2, 64>> binary(new StaticRecursiveModelIndex<long, long, 2, 64>());
+    BOOST_REQUIRE(binary->build(data, firstStage));
+    checkAllFound(*binary, data);
+
+    std::unique_ptr<StaticRecursiveModelIndex<long, long, 2, 64, LinearSplineModel, ExponentialSearch>> spline(
+            new StaticRecursiveModelIndex<long, long, 2, 64, LinearSplineModel, ExponentialSearch>());
+    BOOST_REQUIRE(spline->build(data, firstStage));
+    checkAllFound(*spline, data);
+
+    std::unique_ptr<StaticRecursiveModelIndex<long, long, 2, 64, LinearRegressionModel, LinearSearch>> linear(
+            new StaticRecursiveModelIndex<long, long, 2, 64, LinearRegressionModel, LinearSearch>());
+    BOOST_REQUIRE(linear->build(data, firstStage));
+    checkAllFound(*linear, data);
+}
+
+BOOST_AUTO_TEST_CASE(static_index_with_imported_second_stage) {
+    auto data = makeData();
+    auto firstStage = makeFirstStage(data);
+
+    // Deliberately bad models, the error bounds must still cover every key
+    std::vector<LinearModelWeights> secondStage(16);
+    for (size_t stage = 0; stage < secondStage.size(); ++stage) {
+        secondStage[stage].weight = 0.5f / data.back().first;
+        secondStage[stage].bias = 0.01f * stage;
+    }
+
+    StaticRecursiveModelIndex<long, long, 2, 16, LinearRegressionModel, ExponentialSearch> index;
+    BOOST_REQUIRE(index.build(data, firstStage, secondStage));
+    checkAllFound(index, data);
+
+    // Wrong shapes and unsorted data are rejected
+    secondStage.pop_back();
+    BOOST_CHECK(!index.build(data, firstStage, secondStage));
+    StaticRecursiveModelIndex<long, long, 3, 16> wrongWidth;
+    BOOST_CHECK(!wrongWidth.build(data, firstStage));
+    std::swap(data.front(), data.back());
+    BOOST_CHECK(!index.build(data, firstStage));
+}
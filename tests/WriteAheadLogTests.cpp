@@ -0,0 +1,156 @@
+/**
+ * @file WriteAheadLogTests.cpp
+ *
+ * @brief Tests of the insert write ahead log and data snapshots
+ *
+ * @date 10/18/2026
+ */
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE WriteAheadLogTests
+
+#include <boost/test/unit_test.hpp>
+#include <cstdio>
+#include <fstream>
+#include "../src/utils/Snapshot.h"
+#include "../src/utils/WriteAheadLog.h"
+
+namespace {
+    typedef std::vector<std::pair<long, int>> Records;
+
+    Records replayLog(const std::string &path, WriteAheadLog<long, int> &log, size_t syncBatchSize = 4) {
+        Records replayed;
+        BOOST_REQUIRE(log.open(path, syncBatchSize, [&](uint64_t, long key, int value) {
+            replayed.push_back({key, value});
+        }));
+        return replayed;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(write_ahead_log_replays_after_reopen) {
+    const std::string path = "write_ahead_log_test.wal";
+    std::remove(path.c_str());
+
+    {
+        WriteAheadLog<long, int> log;
+        BOOST_CHECK(replayLog(path, log).empty());
+        for (int ii = 0; ii < 10; ++ii) {
+            BOOST_REQUIRE(log.append(ii * 100L, ii));
+        }
+        BOOST_CHECK_EQUAL(log.lastSequenceNumber(), 10);
+        BOOST_CHECK_EQUAL(log.numRecords(), 10);
+    }
+
+    // Closing synced the partial batch too
+    WriteAheadLog<long, int> log;
+    Records replayed = replayLog(path, log);
+    BOOST_REQUIRE_EQUAL(replayed.size(), 10);
+    BOOST_CHECK_EQUAL(replayed[7].first, 700);
+    BOOST_CHECK_EQUAL(replayed[7].second, 7);
+
+    // Sequence numbers carry on past a truncate, and a reopen only sees records after it
+    BOOST_CHECK_EQUAL(log.numRecords(), 10);
+    BOOST_REQUIRE(log.truncate());
+    BOOST_CHECK_EQUAL(log.numRecords(), 0);
+    BOOST_REQUIRE(log.append(5000, 50));
+    log.close();
+    replayed = replayLog(path, log);
+    BOOST_REQUIRE_EQUAL(replayed.size(), 1);
+    BOOST_CHECK_EQUAL(log.lastSequenceNumber(), 11);
+    BOOST_CHECK_EQUAL(log.numRecords(), 1);
+    log.close();
+
+    // A log of another record type is rejected
+    WriteAheadLog<int, int> otherLog;
+    BOOST_CHECK(!otherLog.open(path, 1, [](uint64_t, int, int) {}));
+    std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(write_ahead_log_discards_torn_tail) {
+    const std::string path = "write_ahead_log_torn_test.wal";
+    std::remove(path.c_str());
+
+    {
+        WriteAheadLog<long, int> log;
+        replayLog(path, log, 1);
+        for (int ii = 0; ii < 5; ++ii) {
+            log.append(ii, ii);
+        }
+    }
+
+    // A crash halfway through a record, then garbage
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::app);
+        file.write("\x06\0\0\0\0\0\0\0\x2a", 9);
+    }
+
+    WriteAheadLog<long, int> log;
+    BOOST_CHECK_EQUAL(replayLog(path, log).size(), 5);
+    BOOST_REQUIRE(log.append(99, 99));
+    log.close();
+
+    Records replayed = replayLog(path, log);
+    BOOST_REQUIRE_EQUAL(replayed.size(), 6);
+    BOOST_CHECK_EQUAL(replayed.back().first, 99);
+    log.close();
+    std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(write_ahead_log_closes_when_truncate_fails) {
+    const std::string path = "write_ahead_log_truncate_test.wal";
+    const std::string temporaryPath = path + ".tmp";
+    std::remove(path.c_str());
+
+    WriteAheadLog<long, int> log;
+    replayLog(path, log, 1);
+    BOOST_REQUIRE(log.append(1, 1));
+
+    // The empty log can't be written next to the old one, which must stay intact and stop taking appends
+    BOOST_REQUIRE_EQUAL(mkdir(temporaryPath.c_str(), 0755), 0);
+    BOOST_CHECK(!log.truncate());
+    BOOST_CHECK(!log.isOpen());
+    BOOST_CHECK(!log.append(2, 2));
+    rmdir(temporaryPath.c_str());
+
+    Records replayed = replayLog(path, log);
+    BOOST_REQUIRE_EQUAL(replayed.size(), 1);
+    BOOST_CHECK_EQUAL(replayed[0].first, 1);
+
+    // Once it can be written, the empty log replaces the old one
+    BOOST_REQUIRE(log.truncate());
+    BOOST_REQUIRE(log.append(3, 3));
+    log.close();
+    replayed = replayLog(path, log);
+    BOOST_REQUIRE_EQUAL(replayed.size(), 1);
+    BOOST_CHECK_EQUAL(replayed[0].first, 3);
+    BOOST_CHECK_EQUAL(log.lastSequenceNumber(), 2);
+    log.close();
+    std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(snapshot_round_trip) {
+    const std::string path = "snapshot_test.snap";
+    Records data;
+    for (int ii = 0; ii < 100000; ++ii) {
+        data.push_back({ii * 3L, -ii});
+    }
+    BOOST_REQUIRE(saveSnapshot(path, data, 42));
+    BOOST_CHECK(snapshotExists(path));
+
+    Records loaded;
+    uint64_t sequenceNumber = 0;
+    BOOST_REQUIRE(loadSnapshot(path, loaded, sequenceNumber));
+    BOOST_CHECK_EQUAL(sequenceNumber, 42);
+    BOOST_CHECK(loaded == data);
+
+    // Flip one byte in the data
+    {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(1000);
+        file.put('\x7f');
+    }
+    Records corrupt;
+    BOOST_CHECK(!loadSnapshot(path, corrupt, sequenceNumber));
+    BOOST_CHECK(corrupt.empty());
+    std::remove(path.c_str());
+}